@@ -0,0 +1,135 @@
+/*
+  Runs MQTTBenchmark against FakeEsp (ESP8266 + local echo broker) on the virtual clock.
+  See README.md for the build command and options.
+*/
+#include <string>
+#include "FakeEsp.h"
+#include "EspDrv.h"
+#include "MQTTClient.h"
+#include "MQTTBenchmark.h"
+
+static const char* benchTopic = "bench/echo";
+static MQTTBenchmark* benchmark = nullptr;
+
+static void MessageReceived(char* topic, uint8_t* payload, uint16_t length)
+{
+  benchmark->MessageReceived(topic, payload, length);
+}
+
+static void Usage()
+{
+  fprintf(stderr, "usage: espbench [--count N] [--rate MSG_PER_S] [--size BYTES] [--latency MS] [--jitter MS] [--loss PER_MILLE] [--baud N]\n"
+    "                [--rxbuf BYTES] [--timedwrite 0|1] [--halfduplex 0|1] [--pace 0|1]\n"
+    "                [--budget MS] [--dtim N] [--waketime MS]\n");
+}
+
+int main(int argc, char** argv)
+{
+  FakeEspConfig config;
+  unsigned long count = 200;
+  unsigned long rate = 5;
+  unsigned long size = 32;
+  bool pace = false;
+  // Bez --budget se úsporný režim nenastavuje
+  unsigned long budget = DEADLINE_NONE;
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if(i + 1 >= argc)
+    {
+      Usage();
+      return 2;
+    }
+    unsigned long value = strtoul(argv[++i], nullptr, 10);
+    if(arg == "--count") count = value;
+    else if(arg == "--rate") rate = value;
+    else if(arg == "--size") size = value;
+    else if(arg == "--latency") config.latency = value;
+    else if(arg == "--jitter") config.jitter = value;
+    else if(arg == "--loss") config.lossPerMille = (uint16_t)value;
+    else if(arg == "--baud") config.baud = value;
+    else if(arg == "--rxbuf") config.rxBuffer = (uint16_t)value;
+    else if(arg == "--timedwrite") config.timedWrite = value != 0;
+    else if(arg == "--halfduplex") config.halfDuplex = value != 0;
+    else if(arg == "--pace") pace = value != 0;
+    else if(arg == "--budget") budget = value;
+    else if(arg == "--dtim") config.dtimPeriod = (uint8_t)value;
+    else if(arg == "--waketime") config.wakeTime = value;
+    else
+    {
+      Usage();
+      return 2;
+    }
+  }
+  if(count == 0 || count > 65535 || rate == 0 || config.baud == 0 || config.dtimPeriod == 0)
+  {
+    Usage();
+    return 2;
+  }
+
+  Serial.quiet = true;
+  HostClock::Set(0);
+  randomSeed(1);
+  FakeEsp esp(config);
+  EspDrv drv(&esp);
+  MQTTClient client(&drv, MessageReceived);
+  MQTTBenchmark bench(&client, benchTopic);
+  benchmark = &bench;
+
+  drv.Init(128);
+  if(pace)
+  {
+    drv.SetTxPacing(config.baud, config.rxBuffer > 0 ? config.rxBuffer : 64);
+  }
+  if(budget != DEADLINE_NONE)
+  {
+    drv.SetDtimPeriod(config.dtimPeriod);
+    drv.SetLatencyBudget(budget);
+  }
+  MQTTConnectData connectData = { "broker.local", 1883, "bench", NULL, NULL, NULL, 0, false, NULL, true, 60 };
+  if(!client.Connect(connectData))
+  {
+    fprintf(stderr, "connect failed\n");
+    return 1;
+  }
+  client.Subscribe(benchTopic, 0);
+
+  bench.Start((uint16_t)count, (uint16_t)rate, (uint8_t)size);
+  unsigned long loops = 0;
+  while(bench.Loop())
+  {
+    client.Loop();
+    loops++;
+    // Spí do nejbližšího termínu nebo příchodu dat z modulu
+    unsigned long wait = min(bench.NextDeadline(), client.NextDeadline());
+    uint64_t now = HostClock::Now();
+    uint64_t wake = wait == DEADLINE_NONE ? UINT64_MAX : now + (uint64_t)wait * 1000;
+    uint64_t arrival = esp.NextArrival();
+    wake = arrival < wake ? arrival : wake;
+    if(wake > now && wake != UINT64_MAX)
+    {
+      HostClock::Set(wake);
+    }
+  }
+
+  HostSerial out;
+  bench.PrintSummary(&out);
+  printf("Broker published %lu echoed %lu lost %lu, %lu loop passes, %lu s virtual\n",
+    esp.published, esp.echoed, esp.lost, loops, (unsigned long)(HostClock::Now() / 1000000));
+  const EspDrvStats& stats = drv.GetStats();
+  printf("UART RX lost %lu (buffer full %lu, during TX %lu); framing resyncs %u, length errors %u, data timeouts %u\n",
+    esp.rxOverflows + esp.rxCollisions, esp.rxOverflows, esp.rxCollisions, stats.ipdResyncs, stats.ipdLengthErrors, stats.dataTimeouts);
+  printf("TX chunks %u, dropped %u, RX bytes between chunks %u, waits for module %u\n",
+    stats.txChunks, stats.txDropped, stats.txInterleaved, stats.txRxWaits);
+  if(budget != DEADLINE_NONE)
+  {
+    static const char* const modes[] = { "none", "light", "modem" };
+    float hours = millis() / 3600000.0;
+    printf("Sleep %s (latency %lu ms): active %lu ms, modem %lu ms, light %lu ms; %.2f mA average\n",
+      modes[drv.GetSleepMode()], drv.GetSleepLatency(drv.GetSleepMode()), drv.GetSleepTime(ESP_SLEEP_NONE),
+      drv.GetSleepTime(ESP_SLEEP_MODEM), drv.GetSleepTime(ESP_SLEEP_LIGHT), hours > 0 ? drv.GetCharge() / hours : 0.0);
+    printf("Wake-ups %u (module %lu), retries %u, re-armed %u, bytes lost to sleep %lu\n",
+      stats.wakeups, esp.wakeups, stats.wakeRetries, stats.sleepRearms, esp.wakeLost);
+  }
+  return 0;
+}
@@ -0,0 +1,212 @@
+/*
+  Publishes config and log messages with and without payload compression through FakeEsp
+  at 57600 baud with blocking writes: payload bytes, UART bytes, time spent in Publish and
+  the ratio from MQTTCompressStats. The echoes are decompressed and compared. Encode/decode
+  time is measured on the PC, the virtual clock does not model CPU time.
+  See README.md.
+*/
+#include <chrono>
+#include <string>
+#include "FakeEsp.h"
+#include "EspDrv.h"
+#include "MQTTClient.h"
+
+static const char* configTopic = "greenhouse/north/config";
+static const char* logTopic = "greenhouse/north/log";
+MQTT_TOPIC(logTopicName, "greenhouse/north/log");
+
+static const char* config =
+  "{\"device\":\"gh-north\",\"wifi\":{\"ssid\":\"greenhouse\",\"channel\":6,\"power\":\"auto\"},"
+  "\"mqtt\":{\"broker\":\"broker.local\",\"port\":1883,\"keepalive\":60},\"sensors\":["
+  "{\"id\":\"t1\",\"type\":\"temperature\",\"interval\":60,\"unit\":\"C\"},"
+  "{\"id\":\"t2\",\"type\":\"temperature\",\"interval\":60,\"unit\":\"C\"},"
+  "{\"id\":\"h1\",\"type\":\"humidity\",\"interval\":60,\"unit\":\"%\"},"
+  "{\"id\":\"s1\",\"type\":\"soil\",\"interval\":300,\"unit\":\"%\"}],"
+  "\"heater\":{\"enabled\":true,\"min\":12,\"max\":18}}";
+
+static const char* logLines[] =
+{
+  "06:12:01 INFO wifi: connected to greenhouse ch 6 rssi -61\n",
+  "06:12:02 INFO mqtt: connected to broker.local:1883 keepalive 60\n",
+  "06:12:02 INFO mqtt: subscribed greenhouse/north/config\n",
+  "06:13:01 INFO sensor t1: temperature 21.5 C\n",
+  "06:13:01 INFO sensor t2: temperature 21.3 C\n",
+  "06:13:01 INFO sensor h1: humidity 48 %\n",
+  "06:13:05 WARN sensor s1: soil read retry 1\n",
+  "06:14:01 INFO sensor t1: temperature 21.6 C\n"
+};
+
+static std::string logBatch;
+static unsigned long echoes = 0;
+static unsigned long mismatches = 0;
+
+static void MessageReceived(char* topic, uint8_t* payload, uint16_t length)
+{
+  const std::string& sent = strcmp(topic, configTopic) == 0 ? std::string(config) : logBatch;
+  echoes++;
+  if(length != sent.size() || memcmp(payload, sent.data(), length) != 0)
+  {
+    mismatches++;
+  }
+}
+
+static unsigned long handleEchoes = 0;
+
+static void HandleReceived(MQTTTopicHandle topic, uint8_t* payload, uint16_t length)
+{
+  handleEchoes++;
+  if(length != logBatch.size() || memcmp(payload, logBatch.data(), length) != 0)
+  {
+    mismatches++;
+  }
+}
+
+static void Idle(MQTTClient& client, unsigned long ms)
+{
+  unsigned long t = millis();
+  while(millis() - t < ms)
+  {
+    client.Loop();
+  }
+}
+
+template<typename F>
+static double MicrosPerCall(F code)
+{
+  const unsigned long calls = 20000;
+  volatile uint16_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for(unsigned long i = 0; i < calls; i++)
+  {
+    sink += code();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::micro>(elapsed).count() / calls;
+}
+
+static void Check(bool condition, const char* what)
+{
+  printf("%-44s %s\n", what, condition ? "ok" : "FAILED");
+}
+
+int main(int argc, char** argv)
+{
+  unsigned long rounds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10;
+  if(rounds == 0)
+  {
+    fprintf(stderr, "usage: espcompress [ROUNDS]\n");
+    return 2;
+  }
+  Serial.quiet = getenv("VERBOSE") == nullptr;
+  randomSeed(1);
+  for(const char* line : logLines)
+  {
+    logBatch += line;
+  }
+
+  FakeEspConfig espConfig;
+  espConfig.jitter = 0;
+  espConfig.timedWrite = true;
+  static uint8_t compressBuffer[512];
+  static uint8_t receiveBuffer[512];
+  printf("%-28s %8s %8s %8s %10s\n", "", "payload", "wire", "UART", "publish");
+  for(uint8_t compress = 0; compress < 2; compress++)
+  {
+    HostClock::Set(0);
+    FakeEsp esp(espConfig);
+    EspDrv drv(&esp);
+    MQTTClientStatic<512> client(&drv, MessageReceived);
+    drv.SetReceiveBuffer(receiveBuffer, sizeof(receiveBuffer));
+    drv.Init(0);
+    if(compress)
+    {
+      client.EnableCompression(configTopic);
+      client.EnableCompression("greenhouse/north/log/#");
+      client.SetCompressBuffer(compressBuffer, sizeof(compressBuffer));
+    }
+    MQTTConnectData connectData = { "broker.local", 1883, "gh-north", NULL, NULL, NULL, 0, false, NULL, true, 60 };
+    client.Connect(connectData);
+    client.Subscribe(configTopic, 0);
+    client.Subscribe(logTopic, 0);
+    Idle(client, 200);
+    echoes = 0;
+    mismatches = 0;
+    const char* topics[] = { configTopic, logTopic };
+    const std::string payloads[] = { std::string(config), logBatch };
+    for(uint8_t m = 0; m < 2; m++)
+    {
+      unsigned long uart = esp.uartTx;
+      unsigned long wire = esp.dataTx;
+      uint64_t elapsed = 0;
+      for(unsigned long i = 0; i < rounds; i++)
+      {
+        uint64_t start = HostClock::Now();
+        client.Publish(topics[m], (const uint8_t*)payloads[m].data(), payloads[m].size());
+        elapsed += HostClock::Now() - start;
+        // Mezera delší než ESP_SEND_GAP_MAX, Publish nečeká na předchozí odeslání
+        Idle(client, 1100);
+      }
+      const MQTTCompressStats* stats = client.GetCompressStats(topics[m]);
+      std::string name = std::string(m == 0 ? "config" : "log") + (compress ? " compressed" : "");
+      printf("%-28s %6lu B %6lu B %6lu B %7.1f ms\n", name.c_str(),
+        stats != nullptr ? (unsigned long)(stats->wireBytes / (2 * rounds)) : (unsigned long)payloads[m].size(),
+        (esp.dataTx - wire) / rounds, (esp.uartTx - uart) / rounds, elapsed / 1000.0 / rounds);
+      if(stats != nullptr)
+      {
+        uint8_t out[512];
+        uint8_t back[512];
+        uint16_t packed = MQTTCompress::Encode((const uint8_t*)payloads[m].data(), payloads[m].size(), out, sizeof(out));
+        printf("%-28s ratio %.2f, encoded %u stored %u decoded %u, encode %.1f us decode %.1f us on the PC\n", "",
+          (double)stats->wireBytes / stats->rawBytes, stats->encoded, stats->stored, stats->decoded,
+          MicrosPerCall([&]() { return MQTTCompress::Encode((const uint8_t*)payloads[m].data(), payloads[m].size(), out, sizeof(out)); }),
+          MicrosPerCall([&]() { uint16_t n = 0; MQTTCompress::Decode(out, packed, back, sizeof(back), &n); return n; }));
+      }
+    }
+    Check(echoes == 2 * rounds && mismatches == 0, compress ? "compressed echoes decoded" : "plain echoes received");
+  }
+
+  // Filtr podle jména platí i pro téma z registru, '#' uvnitř úrovně je obyčejný znak.
+  // Tabulka komprimovaných témat je statická, statistiky se proto porovnávají rozdílem.
+  {
+    HostClock::Set(0);
+    FakeEsp esp(espConfig);
+    EspDrv drv(&esp);
+    MQTTClientStatic<512> client(&drv, MessageReceived);
+    MQTTTopicRegistry registry(2);
+    MQTTTopicHandle log = registry.Register(logTopicName);
+    client.SetTopicRegistry(&registry, HandleReceived);
+    drv.SetReceiveBuffer(receiveBuffer, sizeof(receiveBuffer));
+    drv.Init(0);
+    client.EnableCompression("greenhouse/north/log/#");
+    client.EnableCompression("greenhouse/south/lo#");
+    client.SetCompressBuffer(compressBuffer, sizeof(compressBuffer));
+    MQTTConnectData connectData = { "broker.local", 1883, "gh-north", NULL, NULL, NULL, 0, false, NULL, true, 60 };
+    client.Connect(connectData);
+    client.Subscribe(logTopic, 0);
+    Idle(client, 200);
+    const MQTTCompressStats* stats = client.GetCompressStats(log);
+    uint16_t encoded = stats != nullptr ? stats->encoded : 0;
+    uint16_t decoded = stats != nullptr ? stats->decoded : 0;
+    mismatches = 0;
+    client.Publish(log, (const uint8_t*)logBatch.data(), logBatch.size());
+    Idle(client, 1100);
+    Check(stats != nullptr && stats->encoded == encoded + 1 && stats->decoded == decoded + 1 && handleEchoes == 1 && mismatches == 0,
+      "name filter covers a registry handle");
+    Check(client.GetCompressStats("greenhouse/south/log") == nullptr && client.GetCompressStats("greenhouse/south/lo#") != nullptr,
+      "'#' inside a level is not a wildcard");
+  }
+
+  // Náhodná data se nezmenší a jdou s hlavičkou MQTT_COMPRESS_NONE
+  uint8_t noise[200];
+  for(uint8_t& b : noise)
+  {
+    b = random(256);
+  }
+  uint8_t out[512];
+  Check(MQTTCompress::Encode(noise, sizeof(noise), out, sizeof(out)) == 0, "incompressible payload stored");
+  uint16_t length = MQTTCompress::Encode((const uint8_t*)config, strlen(config), out, sizeof(out));
+  uint8_t back[512];
+  uint16_t backLength = 0;
+  Check(length > 0 && !MQTTCompress::Decode(out, length, back, strlen(config) - 1, &backLength), "decode overflow detected");
+  return 0;
+}
@@ -0,0 +1,108 @@
+#ifndef __HOST_ARDUINO_H
+#define __HOST_ARDUINO_H
+
+/*
+  Minimal Arduino API for compiling the library on a PC (replay and benchmark tools).
+  Time is virtual: see HostClock below.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <math.h>
+#include <avr/pgmspace.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+
+#define DEC 10
+#define HEX 16
+#define BIN 2
+
+#ifndef min
+#define min(a,b) ((a)<(b)?(a):(b))
+#endif
+#ifndef max
+#define max(a,b) ((a)>(b)?(a):(b))
+#endif
+#define constrain(x,l,h) ((x)<(l)?(l):((x)>(h)?(h):(x)))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+void noInterrupts();
+void interrupts();
+
+// Virtuální čas. Každé volání millis()/micros() posune čas o tick (simulace práce CPU),
+// delay() posune čas o zadanou dobu.
+namespace HostClock
+{
+  uint64_t Now();
+  void Set(uint64_t us);
+  void Advance(uint64_t us);
+  void SetTick(uint32_t us);
+}
+
+class Print
+{
+  private:
+    size_t PrintNumber(unsigned long n, uint8_t base);
+
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t b) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* str) { return str == nullptr ? 0 : write((const uint8_t*)str, strlen(str)); }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+    virtual void flush() {}
+
+    size_t print(const __FlashStringHelper* s);
+    size_t print(const char* s);
+    size_t print(char c);
+    size_t print(unsigned char n, int base = DEC);
+    size_t print(int n, int base = DEC);
+    size_t print(unsigned int n, int base = DEC);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println();
+    template<typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+    template<typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+class Stream : public Print
+{
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+// Serial vypisuje na stdout (nebo nikam, pokud je quiet)
+class HostSerial : public Stream
+{
+  public:
+    bool quiet = false;
+    void begin(unsigned long baud) {}
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+    size_t write(uint8_t b);
+    using Print::write;
+};
+
+extern HostSerial Serial;
+
+#endif
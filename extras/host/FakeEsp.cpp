@@ -0,0 +1,481 @@
+#include "FakeEsp.h"
+
+FakeEsp::FakeEsp(const FakeEspConfig& config)
+{
+  this->config = config;
+}
+
+void FakeEsp::Reply(const std::string& text, unsigned long delayMs)
+{
+  if(lateReply)
+  {
+    delayMs += wakeReplyDelay;
+    lateReply = false;
+  }
+  pending.insert(std::make_pair(HostClock::Now() + (uint64_t)delayMs * 1000, text));
+}
+
+void FakeEsp::Deliver(const std::string& mqttPacket, unsigned long delayMs)
+{
+  uint64_t arrival = HostClock::Now() + (uint64_t)delayMs * 1000;
+  if(sleepMode != 0)
+  {
+    // AP drží data do beaconu DTIM, z light-sleep se modul ještě probouzí
+    uint64_t dtim = (uint64_t)config.beaconInterval * config.dtimPeriod * 1000;
+    arrival = (arrival + dtim - 1) / dtim * dtim + (sleepMode == 1 ? (uint64_t)config.wakeTime * 1000 : 0);
+  }
+  pending.insert(std::make_pair(arrival, "\r\n+IPD," + std::to_string(mqttPacket.size()) + ":" + mqttPacket));
+}
+
+// Odpovědi, jejichž čas nastal, se převedou na byty s časováním podle UARTu
+void FakeEsp::Pump()
+{
+  uint64_t now = HostClock::Now();
+  uint64_t byteTime = 10000000ULL / config.baud;
+  while(!pending.empty() && pending.begin()->first <= now)
+  {
+    uint64_t t = pending.begin()->first > lastByteTime ? pending.begin()->first : lastByteTime;
+    for(unsigned char c : pending.begin()->second)
+    {
+      t += byteTime;
+      rx.push_back({ t, c });
+    }
+    lastByteTime = t;
+    pending.erase(pending.begin());
+  }
+}
+
+uint64_t FakeEsp::NextArrival()
+{
+  Pump();
+  if(!rx.empty())
+  {
+    return rx.front().time;
+  }
+  return pending.empty() ? UINT64_MAX : pending.begin()->first;
+}
+
+int FakeEsp::available()
+{
+  Pump();
+  uint64_t now = HostClock::Now();
+  size_t count = 0;
+  while(count < rx.size() && rx[count].time <= now)
+  {
+    count++;
+  }
+  // Nepřečtené byty zaplnily buffer, další se nikam nevešly
+  if(config.rxBuffer > 0 && count > config.rxBuffer)
+  {
+    rxOverflows += count - config.rxBuffer;
+    rx.erase(rx.begin() + config.rxBuffer, rx.begin() + count);
+    count = config.rxBuffer;
+  }
+  return count < 64 ? (int)count : 64;
+}
+
+int FakeEsp::peek()
+{
+  return available() ? rx.front().value : -1;
+}
+
+int FakeEsp::read()
+{
+  if(!available())
+  {
+    return -1;
+  }
+  uint8_t b = rx.front().value;
+  rx.pop_front();
+  return b;
+}
+
+size_t FakeEsp::write(uint8_t b)
+{
+  uartTx++;
+  if(config.timedWrite || config.halfDuplex)
+  {
+    uint64_t start = HostClock::Now();
+    HostClock::Advance(10000000ULL / config.baud);
+    Pump();
+    uint64_t end = HostClock::Now();
+    for(auto it = rx.begin(); config.halfDuplex && it != rx.end();)
+    {
+      if(it->time > start && it->time <= end)
+      {
+        it = rx.erase(it);
+        rxCollisions++;
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+  if(lightAsleep || HostClock::Now() < wakeUntil)
+  {
+    if(lightAsleep && wakeGpio)
+    {
+      lightAsleep = false;
+      wakeUntil = HostClock::Now() + (uint64_t)config.wakeTime * 1000;
+      wakeups++;
+      lateReply = wakeReplyDelay > 0;
+    }
+    wakeLost++;
+    return 1;
+  }
+  if(rawRemaining > 0)
+  {
+    packet += (char)b;
+    dataTx++;
+    if(!midSend.empty() && rawRemaining == packet.size())
+    {
+      Deliver(midSend, 0);
+      midSend.clear();
+    }
+    if(--rawRemaining == 0)
+    {
+      Reply("\r\nRecv " + std::to_string(packet.size()) + " bytes\r\n" + beforeSendOk + "\r\nSEND OK\r\n", config.sendDelay);
+      beforeSendOk.clear();
+      if(udp)
+      {
+        Gateway(packet);
+      }
+      else
+      {
+        Broker(packet);
+      }
+      packet.clear();
+    }
+    return 1;
+  }
+  if(b == '\n')
+  {
+    if(!line.empty() && line[line.size() - 1] == '\r')
+    {
+      line.erase(line.size() - 1);
+    }
+    Command(line);
+    line.clear();
+  }
+  else
+  {
+    line += (char)b;
+  }
+  return 1;
+}
+
+void FakeEsp::Drop()
+{
+  tcpConnected = false;
+  Reply("\r\nCLOSED\r\n", 0);
+}
+
+void FakeEsp::Inject(const std::string& text)
+{
+  Reply(text, 0);
+}
+
+void FakeEsp::Command(const std::string& command)
+{
+  commands += command.empty() ? 0 : 1;
+  if(command.compare(0, 11, "AT+CIPSEND=") == 0)
+  {
+    rawRemaining = (uint16_t)atoi(command.c_str() + 11);
+    Reply(tcpConnected ? "\r\nOK\r\n> " : "\r\nlink is not valid\r\n\r\nERROR\r\n", config.commandDelay);
+    if(!tcpConnected)
+    {
+      rawRemaining = 0;
+    }
+  }
+  else if(command == "AT+CIPSTATUS")
+  {
+    std::string link = udp ? "\"UDP\",\"127.0.0.1\",1884,1884,0" : "\"TCP\",\"127.0.0.1\",1883,1,0";
+    Reply(tcpConnected ? "\r\nSTATUS:3\r\n+CIPSTATUS:0," + link + "\r\n\r\nOK\r\n" : "\r\nSTATUS:2\r\n\r\nOK\r\n", config.commandDelay);
+  }
+  else if(command.compare(0, 12, "AT+CIPSTART=") == 0)
+  {
+    tcpConnected = true;
+    udp = command.find("\"UDP\"") != std::string::npos;
+    // UDP "spojení" je jen lokální nastavení modulu, stav brány trvá
+    if(!udp)
+    {
+      subscriptions.clear();
+    }
+    Reply("\r\nCONNECT\r\n\r\nOK\r\n", udp ? config.commandDelay : config.latency);
+  }
+  else if(command == "AT+CIPCLOSE")
+  {
+    tcpConnected = false;
+    Reply("\r\nCLOSED\r\n\r\nOK\r\n", config.commandDelay);
+  }
+  else if(command.compare(0, 13, "AT+CIPDOMAIN=") == 0)
+  {
+    Reply("\r\n+CIPDOMAIN:127.0.0.1\r\n\r\nOK\r\n", config.latency);
+  }
+  else if(command.compare(0, 9, "AT+SLEEP=") == 0)
+  {
+    sleepMode = atoi(command.c_str() + 9);
+    lightAsleep = sleepMode == 1;
+    Reply("\r\nOK\r\n", config.commandDelay);
+  }
+  else if(command.compare(0, 15, "AT+WAKEUPGPIO=1") == 0)
+  {
+    wakeGpio = true;
+    Reply("\r\nOK\r\n", config.commandDelay);
+  }
+  else if(command == "AT+RST")
+  {
+    sleepMode = 0;
+    lightAsleep = false;
+    wakeGpio = false;
+    Reply("\r\nOK\r\n", config.commandDelay);
+  }
+  else if(command == "AT+CWJAP_CUR?")
+  {
+    Reply("\r\n+CWJAP_CUR:\"host\",\"02:00:00:00:00:01\",1,-40\r\n\r\nOK\r\n", config.commandDelay);
+  }
+  else if(command.compare(0, 2, "AT") != 0 && !command.empty())
+  {
+    // Příkaz, kterému chybí začátek (ztracený při probouzení)
+    Reply("\r\nERROR\r\n", config.commandDelay);
+  }
+  else if(!command.empty())
+  {
+    Reply("\r\nOK\r\n", config.commandDelay);
+  }
+}
+
+void FakeEsp::Broker(const std::string& mqttPacket)
+{
+  uint8_t type = (uint8_t)mqttPacket[0] & 0xF0;
+  // Přeskočí Remaining Length (1 až 4 byty)
+  size_t offset = 1;
+  while(offset < mqttPacket.size() && ((uint8_t)mqttPacket[offset++] & 0x80) != 0)
+  {
+  }
+  switch(type)
+  {
+    case 0x10:
+      connects++;
+      Deliver(std::string("\x20\x02\x00", 3) + (char)connackCode, config.latency);
+      if(connackCode != 0)
+      {
+        tcpConnected = false;
+        Reply("\r\nCLOSED\r\n", config.latency + 1);
+      }
+    break;
+    case 0x80:
+    {
+      // SUBSCRIBE: packet id, topic, QoS
+      uint16_t topicLength = ((uint8_t)mqttPacket[offset + 2] << 8) | (uint8_t)mqttPacket[offset + 3];
+      std::string topic = mqttPacket.substr(offset + 4, topicLength);
+      uint8_t qos = (uint8_t)mqttPacket[offset + 4 + topicLength];
+      subscriptions.insert(topic);
+      Deliver(std::string("\x90\x03", 2) + mqttPacket.substr(offset, 2) + std::string(1, (char)qos), config.latency);
+    }
+    break;
+    case 0xC0:
+      Deliver(std::string("\xD0\x00", 2), config.latency);
+    break;
+    case 0x30:
+    {
+      published++;
+      uint16_t topicLength = ((uint8_t)mqttPacket[offset] << 8) | (uint8_t)mqttPacket[offset + 1];
+      std::string topic = mqttPacket.substr(offset + 2, topicLength);
+      if(subscriptions.count(topic) == 0)
+      {
+        break;
+      }
+      if(config.lossPerMille > 0 && random(1000) < config.lossPerMille)
+      {
+        lost++;
+        break;
+      }
+      echoed++;
+      // Echo s QoS 0, retain se nepřenáší
+      std::string echo = mqttPacket;
+      echo[0] = (char)0x30;
+      Deliver(echo, config.latency + (config.jitter > 0 ? random(config.jitter + 1) : 0));
+    }
+    break;
+    case 0xE0:
+      tcpConnected = false;
+      Reply("\r\nCLOSED\r\n", config.commandDelay);
+    break;
+  }
+}
+
+void FakeEsp::DeliverSn(uint8_t type, const std::string& body, unsigned long delayMs)
+{
+  std::string message;
+  if(body.size() + 2 < 256)
+  {
+    message += (char)(body.size() + 2);
+  }
+  else
+  {
+    message += '\x01';
+    message += (char)((body.size() + 4) >> 8);
+    message += (char)((body.size() + 4) & 0xFF);
+  }
+  message += (char)type;
+  Deliver(message + body, delayMs);
+}
+
+bool FakeEsp::SnTopic(uint8_t flags, uint16_t topicId, std::string* topic)
+{
+  switch(flags & 0x03)
+  {
+    case 0:
+      if(snTopicNames.count(topicId) == 0)
+      {
+        return false;
+      }
+      *topic = snTopicNames[topicId];
+    return true;
+    case 1:
+      if(predefined.count(topicId) == 0)
+      {
+        return false;
+      }
+      *topic = predefined[topicId];
+    return true;
+    case 2:
+      *topic = std::string(1, (char)(topicId >> 8)) + (char)(topicId & 0xFF);
+    return true;
+  }
+  return false;
+}
+
+static std::string Word(uint16_t value)
+{
+  return std::string(1, (char)(value >> 8)) + (char)(value & 0xFF);
+}
+
+// MQTT-SN brána: jedna relace, id témat sdílená pro REGISTER i SUBSCRIBE
+void FakeEsp::Gateway(const std::string& message)
+{
+  size_t header = (uint8_t)message[0] == 0x01 ? 3 : 1;
+  if(message.size() < header + 1)
+  {
+    return;
+  }
+  uint8_t type = (uint8_t)message[header];
+  std::string body = message.substr(header + 1);
+  switch(type)
+  {
+    case 0x04:
+      // CONNECT: flags, protocol id, duration, client id
+      snAsleep = false;
+      if((uint8_t)body[0] & 0x04)
+      {
+        subscriptions.clear();
+        snTopicIds.clear();
+        snTopicNames.clear();
+        snParked.clear();
+      }
+      DeliverSn(0x05, std::string(1, '\0'), config.latency);
+    break;
+    case 0x0A:
+    {
+      // REGISTER: topic id (0), msg id, jméno
+      std::string topic = body.substr(4);
+      if(snTopicIds.count(topic) == 0)
+      {
+        uint16_t id = (uint16_t)(snTopicIds.size() + 1);
+        snTopicIds[topic] = id;
+        snTopicNames[id] = topic;
+      }
+      DeliverSn(0x0B, Word(snTopicIds[topic]) + body.substr(2, 2) + std::string(1, '\0'), config.latency);
+    }
+    break;
+    case 0x12:
+    {
+      // SUBSCRIBE: flags, msg id, jméno nebo id
+      uint8_t flags = (uint8_t)body[0];
+      std::string topic;
+      uint16_t id = 0;
+      if((flags & 0x03) == 0)
+      {
+        topic = body.substr(3);
+        if(snTopicIds.count(topic) == 0)
+        {
+          id = (uint16_t)(snTopicIds.size() + 1);
+          snTopicIds[topic] = id;
+          snTopicNames[id] = topic;
+        }
+        id = snTopicIds[topic];
+      }
+      else
+      {
+        id = ((uint8_t)body[3] << 8) | (uint8_t)body[4];
+        if(!SnTopic(flags, id, &topic))
+        {
+          DeliverSn(0x13, std::string(1, (char)(flags & 0x60)) + Word(0) + body.substr(1, 2) + std::string(1, '\x02'), config.latency);
+          break;
+        }
+      }
+      subscriptions.insert(topic);
+      DeliverSn(0x13, std::string(1, (char)(flags & 0x60)) + Word(id) + body.substr(1, 2) + std::string(1, '\0'), config.latency);
+    }
+    break;
+    case 0x0C:
+    {
+      // PUBLISH: flags, topic id, msg id, data
+      uint8_t flags = (uint8_t)body[0];
+      uint16_t id = ((uint8_t)body[1] << 8) | (uint8_t)body[2];
+      std::string topic;
+      if(!SnTopic(flags, id, &topic))
+      {
+        if((flags & 0x60) != 0x60)
+        {
+          DeliverSn(0x0D, body.substr(1, 4) + std::string(1, '\x02'), config.latency);
+        }
+        break;
+      }
+      published++;
+      if((flags & 0x60) == 0x20)
+      {
+        DeliverSn(0x0D, body.substr(1, 4) + std::string(1, '\0'), config.latency);
+      }
+      if(subscriptions.count(topic) == 0)
+      {
+        break;
+      }
+      if(config.lossPerMille > 0 && random(1000) < config.lossPerMille)
+      {
+        lost++;
+        break;
+      }
+      echoed++;
+      // Echo s QoS 0, retain se nepřenáší
+      std::string echo = body;
+      echo[0] = (char)(flags & 0x03);
+      if(snAsleep)
+      {
+        snParked.push_back(echo);
+        break;
+      }
+      DeliverSn(0x0C, echo, config.latency + (config.jitter > 0 ? random(config.jitter + 1) : 0));
+    }
+    break;
+    case 0x16:
+      // PINGREQ s id klienta od spícího klienta: nejdřív zaparkované zprávy
+      if(snAsleep && !body.empty())
+      {
+        for(const std::string& parked : snParked)
+        {
+          DeliverSn(0x0C, parked, config.latency);
+        }
+        snParked.clear();
+      }
+      DeliverSn(0x17, std::string(), config.latency);
+    break;
+    case 0x18:
+      // DISCONNECT s dobou spánku uspí klienta, bez ní relaci ukončí
+      snAsleep = body.size() >= 2;
+      DeliverSn(0x18, std::string(), config.latency);
+    break;
+  }
+}
@@ -0,0 +1,124 @@
+#ifndef __HOST_FAKEESP_H
+#define __HOST_FAKEESP_H
+
+/*
+  ESP8266 AT firmware with a local MQTT broker behind it, for running the library on a PC.
+  Answers the AT commands used by EspDrv, accepts one TCP connection and echoes PUBLISH
+  packets on subscribed topics after a configurable network delay, jitter and loss.
+  Received bytes are paced by the UART baud rate on the virtual clock. Optionally the
+  Arduino side has a bounded RX buffer and a half-duplex UART that loses what arrives
+  while it transmits, as SoftwareSerial does.
+  AT+CIPSTART="UDP" connects to an MQTT-SN gateway instead: it assigns topic ids, knows
+  the predefined topics, echoes PUBLISH the same way and parks messages for sleeping clients.
+  AT+SLEEP=1/2 delays received data to the next DTIM beacon. In light sleep the first byte
+  on the UART wakes the module (with AT+WAKEUPGPIO) and is lost, as is anything sent while it wakes.
+*/
+
+#include <map>
+#include <set>
+#include <string>
+#include <deque>
+#include <Arduino.h>
+
+struct FakeEspConfig
+{
+  unsigned long baud = 57600;
+  // Zpoždění broker -> modul (ms), k němu náhodně 0 až jitter
+  unsigned long latency = 20;
+  unsigned long jitter = 10;
+  // Ztráta echo zpráv v promile
+  uint16_t lossPerMille = 0;
+  // Doba zpracování příkazu modulem (ms)
+  unsigned long commandDelay = 2;
+  unsigned long sendDelay = 10;
+  // RX buffer na straně Arduina (SoftwareSerial 64 B), 0 = neomezený; co přijde do plného, se ztratí
+  uint16_t rxBuffer = 0;
+  // Zápis bytu trvá dobu jeho vysílání (blokující write jako HardwareSerial s plným TX bufferem)
+  bool timedWrite = false;
+  // Navíc se ztratí, co přijde během vysílání (SoftwareSerial); zahrnuje timedWrite
+  bool halfDuplex = false;
+  // Úsporné režimy: interval beaconů (ms) a perioda DTIM, doba probouzení z light-sleep (ms)
+  unsigned long beaconInterval = 102;
+  uint8_t dtimPeriod = 1;
+  unsigned long wakeTime = 3;
+};
+
+class FakeEsp : public Stream
+{
+  private:
+    struct RxByte
+    {
+      uint64_t time;
+      uint8_t value;
+    };
+    FakeEspConfig config;
+    std::multimap<uint64_t, std::string> pending;
+    std::deque<RxByte> rx;
+    uint64_t lastByteTime = 0;
+    std::string line;
+    std::string packet;
+    uint16_t rawRemaining = 0;
+    bool tcpConnected = false;
+    bool udp = false;
+    std::set<std::string> subscriptions;
+    std::map<std::string, uint16_t> snTopicIds;
+    std::map<uint16_t, std::string> snTopicNames;
+    bool snAsleep = false;
+    std::deque<std::string> snParked;
+    int sleepMode = 0;
+    bool lightAsleep = false;
+    bool wakeGpio = false;
+    uint64_t wakeUntil = 0;
+    bool lateReply = false;
+
+    void Pump();
+    void Reply(const std::string& text, unsigned long delayMs);
+    void Deliver(const std::string& mqttPacket, unsigned long delayMs);
+    void Command(const std::string& command);
+    void Broker(const std::string& mqttPacket);
+    void Gateway(const std::string& message);
+    void DeliverSn(uint8_t type, const std::string& body, unsigned long delayMs);
+    bool SnTopic(uint8_t flags, uint16_t topicId, std::string* topic);
+
+  public:
+    unsigned long published = 0;
+    unsigned long echoed = 0;
+    unsigned long lost = 0;
+    // Provoz modulu: byty zapsané do UARTu a AT příkazy
+    unsigned long uartTx = 0;
+    unsigned long commands = 0;
+    // Data odeslaná po síti (za AT+CIPSEND)
+    unsigned long dataTx = 0;
+    // Byty ztracené na straně Arduina: plný RX buffer, příjem během vysílání
+    unsigned long rxOverflows = 0;
+    unsigned long rxCollisions = 0;
+    // Předdefinovaná témata MQTT-SN brány
+    std::map<uint16_t, std::string> predefined;
+    // Probuzení z light-sleep a byty ztracené spícím nebo probouzejícím se modulem
+    unsigned long wakeups = 0;
+    unsigned long wakeLost = 0;
+    // Odpověď na první příkaz po probuzení se zdrží o tolik ms, modul ho přitom provede
+    unsigned long wakeReplyDelay = 0;
+    // Byty vložené jednou před příští SEND OK, např. rámec +IPD, který přišel o byty
+    std::string beforeSendOk;
+    // Paket MQTT doručený jednou jako +IPD, když modul přijme polovinu dat CIPSEND
+    std::string midSend;
+    // Návratový kód v CONNACK, nenulový = broker připojení odmítne a zavře spojení
+    uint8_t connackCode = 0;
+    unsigned long connects = 0;
+
+    FakeEsp(const FakeEspConfig& config);
+    // Virtuální čas příchodu dalšího bytu (us), UINT64_MAX pokud žádný nečeká
+    uint64_t NextArrival();
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t b);
+    // Broker zavře spojení, modul to ohlásí URC CLOSED
+    void Drop();
+    // Výstup modulu mimo odpověď na příkaz, např. BUSY
+    void Inject(const std::string& text);
+    using Print::write;
+};
+
+#endif
@@ -0,0 +1,178 @@
+#include <Arduino.h>
+
+HostSerial Serial;
+
+static uint64_t clockMicros = 0;
+static uint32_t clockTick = 10;
+static unsigned long randomState = 1;
+
+namespace HostClock
+{
+  uint64_t Now()
+  {
+    return clockMicros;
+  }
+
+  void Set(uint64_t us)
+  {
+    clockMicros = us;
+  }
+
+  void Advance(uint64_t us)
+  {
+    clockMicros += us;
+  }
+
+  void SetTick(uint32_t us)
+  {
+    clockTick = us;
+  }
+}
+
+unsigned long millis()
+{
+  clockMicros += clockTick;
+  return (unsigned long)(clockMicros / 1000);
+}
+
+unsigned long micros()
+{
+  clockMicros += clockTick;
+  return (unsigned long)clockMicros;
+}
+
+void delay(unsigned long ms)
+{
+  clockMicros += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  clockMicros += us;
+}
+
+// Deterministický generátor, aby byl replay opakovatelný
+long random(long howBig)
+{
+  if(howBig <= 0)
+  {
+    return 0;
+  }
+  randomState = randomState * 1103515245UL + 12345UL;
+  return (long)((randomState >> 16) % (unsigned long)howBig);
+}
+
+long random(long howSmall, long howBig)
+{
+  if(howSmall >= howBig)
+  {
+    return howSmall;
+  }
+  return howSmall + random(howBig - howSmall);
+}
+
+void randomSeed(unsigned long seed)
+{
+  randomState = seed;
+}
+
+void noInterrupts()
+{
+}
+
+void interrupts()
+{
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+  size_t n = 0;
+  while(size--)
+  {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::PrintNumber(unsigned long n, uint8_t base)
+{
+  char buf[8 * sizeof(long) + 1];
+  char* str = &buf[sizeof(buf) - 1];
+  *str = '\0';
+  if(base < 2)
+  {
+    base = 10;
+  }
+  do
+  {
+    char c = n % base;
+    n /= base;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while(n);
+  return write(str);
+}
+
+size_t Print::print(const __FlashStringHelper* s)
+{
+  return write((const char*)s);
+}
+
+size_t Print::print(const char* s)
+{
+  return write(s);
+}
+
+size_t Print::print(char c)
+{
+  return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char n, int base)
+{
+  return PrintNumber(n, base);
+}
+
+size_t Print::print(int n, int base)
+{
+  return print((long)n, base);
+}
+
+size_t Print::print(unsigned int n, int base)
+{
+  return PrintNumber(n, base);
+}
+
+size_t Print::print(long n, int base)
+{
+  if(base == 10 && n < 0)
+  {
+    return write('-') + PrintNumber((unsigned long)-n, 10);
+  }
+  return PrintNumber((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+  return PrintNumber(n, base);
+}
+
+size_t Print::print(double n, int digits)
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return write(buf);
+}
+
+size_t Print::println()
+{
+  return write('\r') + write('\n');
+}
+
+size_t HostSerial::write(uint8_t b)
+{
+  if(!quiet)
+  {
+    fputc(b, stdout);
+  }
+  return 1;
+}
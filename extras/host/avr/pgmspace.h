@@ -0,0 +1,21 @@
+#ifndef __HOST_PGMSPACE_H
+#define __HOST_PGMSPACE_H
+
+#include <string.h>
+#include <stdio.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const unsigned char*)(addr))
+#define pgm_read_word(addr) (*(const unsigned short*)(addr))
+#define pgm_read_dword(addr) (*(const unsigned long*)(addr))
+#define pgm_read_ptr(addr) (*(void* const*)(addr))
+#define memcpy_P memcpy
+#define memcmp_P memcmp
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define vsnprintf_P vsnprintf
+#define snprintf_P snprintf
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef __HOST_WDT_H
+#define __HOST_WDT_H
+
+inline void wdt_reset() {}
+
+#endif
@@ -0,0 +1,169 @@
+/*
+  Compares the cost of one sensor reading over MQTT (TCP) and MQTT-SN (UDP) against FakeEsp,
+  then exercises subscribe, sleep and check-in of MQTTSNClient. See README.md.
+*/
+#include <string>
+#include "FakeEsp.h"
+#include "EspDrv.h"
+#include "MQTTClient.h"
+#include "MQTTSNClient.h"
+
+static const char* readingTopic = "greenhouse/north/temperature";
+static const char* echoTopic = "greenhouse/north/echo";
+static unsigned long snReceived = 0;
+
+static void MessageReceived(char* topic, uint8_t* payload, uint16_t length)
+{
+}
+
+static void SnMessageReceived(char* topic, uint8_t* payload, uint16_t length)
+{
+  snReceived++;
+}
+
+struct Cost
+{
+  unsigned long uartTx;
+  unsigned long dataTx;
+  unsigned long commands;
+};
+
+static Cost Snapshot(FakeEsp& esp)
+{
+  return { esp.uartTx, esp.dataTx, esp.commands };
+}
+
+static void Report(const char* name, FakeEsp& esp, const Cost& start, unsigned long readings)
+{
+  printf("%-26s %6.1f B network  %6.1f B UART  %4.1f AT commands per reading\n", name,
+    (double)(esp.dataTx - start.dataTx) / readings,
+    (double)(esp.uartTx - start.uartTx) / readings,
+    (double)(esp.commands - start.commands) / readings);
+}
+
+static void Check(bool condition, const char* what)
+{
+  printf("%-40s %s\n", what, condition ? "ok" : "FAILED");
+}
+
+static void Idle(EspDrv& drv, unsigned long ms)
+{
+  unsigned long t = millis();
+  while(millis() - t < ms)
+  {
+    drv.Loop();
+  }
+}
+
+int main(int argc, char** argv)
+{
+  unsigned long readings = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20;
+  if(readings == 0)
+  {
+    fprintf(stderr, "usage: espmqttsn [READINGS]\n");
+    return 2;
+  }
+  const char* value = "21.5";
+  Serial.quiet = getenv("VERBOSE") == nullptr;
+  randomSeed(1);
+  FakeEspConfig config;
+  config.jitter = 0;
+
+  // MQTT 3.1.1 přes TCP
+  {
+    HostClock::Set(0);
+    FakeEsp esp(config);
+    EspDrv drv(&esp);
+    MQTTClient client(&drv, MessageReceived);
+    drv.Init(128);
+    Cost start = Snapshot(esp);
+    MQTTConnectData connectData = { "broker.local", 1883, "sensor-1", NULL, NULL, NULL, 0, false, NULL, true, 60 };
+    client.Connect(connectData);
+    Report("MQTT connect", esp, start, 1);
+    start = Snapshot(esp);
+    for(unsigned long i = 0; i < readings; i++)
+    {
+      client.Publish(readingTopic, value);
+    }
+    Report("MQTT QoS 0", esp, start, readings);
+  }
+
+  // MQTT-SN přes UDP
+  {
+    HostClock::Set(0);
+    FakeEsp esp(config);
+    esp.predefined[1] = "greenhouse/north/humidity";
+    EspDrv drv(&esp);
+    MQTTSNClient client(&drv, SnMessageReceived);
+    client.SetPredefinedTopic("greenhouse/north/humidity", 1);
+    drv.Init(128);
+    Cost start = Snapshot(esp);
+    MQTTSNConnectData connectData = { "gateway.local", 1884, 1884, "sensor-1", true, 60 };
+    Check(client.Connect(connectData), "connect accepted");
+    Report("MQTT-SN connect", esp, start, 1);
+    start = Snapshot(esp);
+    for(unsigned long i = 0; i < readings; i++)
+    {
+      client.Publish(readingTopic, value);
+    }
+    Report("MQTT-SN QoS 0 (registered)", esp, start, readings);
+    start = Snapshot(esp);
+    for(unsigned long i = 0; i < readings; i++)
+    {
+      client.PublishQosM1("greenhouse/north/humidity", (const uint8_t*)value, 4);
+    }
+    Report("MQTT-SN QoS -1 (predefined)", esp, start, readings);
+    Check(esp.published == readings * 2, "gateway received all publishes");
+
+    Check(client.Subscribe(echoTopic, 1), "subscribe");
+    client.Publish(echoTopic, value);
+    Idle(drv, 200);
+    Check(snReceived == 1, "echo delivered");
+
+    // Dvouznakové téma jde publikovat i ve spánku (QoS -1), brána echo podrží do CheckIn
+    Check(client.Subscribe("t1"), "subscribe short topic");
+    Check(client.Sleep(600), "sleep");
+    Check(!client.Publish(echoTopic, value) && client.IsAsleep(), "publish refused while asleep");
+    Check(client.PublishQosM1("t1", (const uint8_t*)value, 4), "QoS -1 while asleep");
+    Idle(drv, 200);
+    Check(snReceived == 1, "nothing delivered while asleep");
+    Check(client.CheckIn() && snReceived == 2, "check-in delivers parked message");
+    Check(client.Login() && !client.IsAsleep(), "wake up");
+    printf("MQTT-SN retransmissions %u, RTT %u ms\n", client.GetRetransmissions(), client.GetRtt().srtt);
+  }
+
+  // Brána odpoví dřív, než modul ohlásí SEND OK; RTT se měří od začátku dat, ne od návratu z Write
+  {
+    HostClock::Set(0);
+    FakeEspConfig slowSend = config;
+    slowSend.latency = 5;
+    slowSend.sendDelay = 30;
+    FakeEsp esp(slowSend);
+    EspDrv drv(&esp);
+    MQTTSNClient client(&drv, SnMessageReceived);
+    drv.Init(128);
+    MQTTSNConnectData connectData = { "gateway.local", 1884, 1884, "sensor-1", true, 60 };
+    client.Connect(connectData);
+    client.Subscribe(echoTopic, 1);
+    client.Subscribe("t1");
+    const RttEstimator& rtt = client.GetRtt();
+    Check(rtt.samples >= 3 && rtt.minRtt >= slowSend.latency && rtt.srtt < slowSend.sendDelay, "RTT measured when the answer beats SEND OK");
+  }
+
+  // QoS -1 bez CONNECT
+  {
+    HostClock::Set(0);
+    FakeEsp esp(config);
+    esp.predefined[7] = "greenhouse/north/battery";
+    EspDrv drv(&esp);
+    MQTTSNClient client(&drv, SnMessageReceived);
+    client.SetPredefinedTopic("greenhouse/north/battery", 7);
+    drv.Init(128);
+    Cost start = Snapshot(esp);
+    client.Open("gateway.local", 1884, 1884);
+    client.PublishQosM1("greenhouse/north/battery", (const uint8_t*)"3.71", 4);
+    Report("MQTT-SN QoS -1 cold start", esp, start, 1);
+    Check(esp.published == 1, "gateway accepted QoS -1 without CONNECT");
+  }
+  return 0;
+}
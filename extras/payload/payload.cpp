@@ -0,0 +1,212 @@
+/*
+  Compares a sensor reading built with snprintf (the old way) against MQTTPayloadWriter
+  in JSON and CBOR: payload bytes, bytes on the network, stack buffers and encode time.
+  The echoes come back through FakeEsp and are decoded with MQTTPayloadReader. See README.md.
+*/
+#include <chrono>
+#include <string>
+#include "FakeEsp.h"
+#include "EspDrv.h"
+#include "MQTTClient.h"
+#include "MQTTPayload.h"
+
+static const char* readingTopic = "greenhouse/north/reading";
+
+struct Reading
+{
+  int16_t temperature;  // desetiny °C
+  uint16_t humidity;    // %
+  uint16_t battery;     // mV
+  bool heater;
+  const char* id;
+  int8_t rssi[3];
+};
+
+static const Reading reading = { 215, 48, 3712, false, "gh-north", { -61, -64, -59 } };
+
+static MQTTPayloadFormat echoFormat = MQTT_PAYLOAD_JSON;
+static unsigned long decoded = 0;
+static unsigned long decodeErrors = 0;
+
+static void WriteReading(MQTTPayloadWriter& payload)
+{
+  payload.BeginMap(6);
+  payload.Key("t");
+  payload.Fixed(reading.temperature, 1);
+  payload.Key("h");
+  payload.Int(reading.humidity);
+  payload.Key("bat");
+  payload.Fixed(reading.battery, 3);
+  payload.Key("heat");
+  payload.Bool(reading.heater);
+  payload.Key("id");
+  payload.Text(reading.id);
+  payload.Key("rssi");
+  payload.BeginArray(3);
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    payload.Int(reading.rssi[i]);
+  }
+  payload.End();
+  payload.End();
+}
+
+static int SprintfReading(char* data, size_t size)
+{
+  return snprintf(data, size, "{\"t\":%.1f,\"h\":%u,\"bat\":%.3f,\"heat\":%s,\"id\":\"%s\",\"rssi\":[%d,%d,%d]}",
+    reading.temperature / 10.0, reading.humidity, reading.battery / 1000.0, reading.heater ? "true" : "false",
+    reading.id, reading.rssi[0], reading.rssi[1], reading.rssi[2]);
+}
+
+static bool DecodeReading(const uint8_t* payload, uint16_t length, MQTTPayloadFormat format)
+{
+  MQTTPayloadReader reader(payload, length, format);
+  if(reader.Next() != MQTT_ITEM_MAP)
+  {
+    return false;
+  }
+  bool ok = true;
+  uint8_t fields = 0;
+  while(reader.Next() == MQTT_ITEM_TEXT)
+  {
+    fields++;
+    if(reader.TextEquals("t"))
+    {
+      reader.Next();
+      ok &= reader.GetFixed(1) == reading.temperature;
+    }
+    else if(reader.TextEquals("bat"))
+    {
+      reader.Next();
+      ok &= reader.GetFixed(3) == reading.battery;
+    }
+    else if(reader.TextEquals("id"))
+    {
+      reader.Next();
+      ok &= reader.GetTextLength() == strlen(reading.id) && memcmp(reader.GetText(), reading.id, reader.GetTextLength()) == 0;
+    }
+    else if(reader.TextEquals("rssi"))
+    {
+      ok &= reader.Next() == MQTT_ITEM_ARRAY;
+      for(uint8_t i = 0; reader.Next() == MQTT_ITEM_INT; i++)
+      {
+        ok &= i < 3 && reader.GetInt() == reading.rssi[i];
+      }
+    }
+    else
+    {
+      reader.Next();
+      reader.Skip();
+    }
+  }
+  // Find přeskočí ostatní klíče i vnořené hodnoty
+  MQTTPayloadReader finder(payload, length, format);
+  ok &= finder.Next() == MQTT_ITEM_MAP && finder.Find("h") && finder.GetInt() == reading.humidity;
+  return ok && fields == 6 && reader.GetType() == MQTT_ITEM_END && reader.Next() == MQTT_ITEM_NONE && reader.IsValid();
+}
+
+static void MessageReceived(char* topic, uint8_t* payload, uint16_t length)
+{
+  if(DecodeReading(payload, length, echoFormat))
+  {
+    decoded++;
+  }
+  else
+  {
+    decodeErrors++;
+  }
+}
+
+template<typename F>
+static double NanosPerCall(F encode)
+{
+  const unsigned long rounds = 200000;
+  volatile uint16_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for(unsigned long i = 0; i < rounds; i++)
+  {
+    sink += encode();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / rounds;
+}
+
+static void Check(bool condition, const char* what)
+{
+  printf("%-44s %s\n", what, condition ? "ok" : "FAILED");
+}
+
+static void Idle(MQTTClient& client, unsigned long ms)
+{
+  unsigned long t = millis();
+  while(millis() - t < ms)
+  {
+    client.Loop();
+  }
+}
+
+int main(int argc, char** argv)
+{
+  unsigned long readings = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20;
+  if(readings == 0)
+  {
+    fprintf(stderr, "usage: esppayload [READINGS]\n");
+    return 2;
+  }
+  Serial.quiet = getenv("VERBOSE") == nullptr;
+  randomSeed(1);
+
+  uint8_t scratch[128];
+  char data[128];
+  MQTTPayloadWriter jsonSize(MQTT_PAYLOAD_JSON);
+  WriteReading(jsonSize);
+  MQTTPayloadWriter cborSize(MQTT_PAYLOAD_CBOR);
+  WriteReading(cborSize);
+  int sprintfLength = SprintfReading(data, sizeof(data));
+  printf("%-20s %8s %10s %10s\n", "", "payload", "buffers", "encode");
+  printf("%-20s %6d B %8u B %7.0f ns\n", "snprintf JSON", sprintfLength, (unsigned)sizeof(data),
+    NanosPerCall([&]() { return (uint16_t)SprintfReading(data, sizeof(data)); }));
+  printf("%-20s %6u B %8u B %7.0f ns\n", "writer JSON", jsonSize.GetLength(), (unsigned)sizeof(MQTTPayloadWriter),
+    NanosPerCall([&]() { MQTTPayloadWriter w(scratch, sizeof(scratch), MQTT_PAYLOAD_JSON); WriteReading(w); return w.GetLength(); }));
+  printf("%-20s %6u B %8u B %7.0f ns\n", "writer CBOR", cborSize.GetLength(), (unsigned)sizeof(MQTTPayloadWriter),
+    NanosPerCall([&]() { MQTTPayloadWriter w(scratch, sizeof(scratch), MQTT_PAYLOAD_CBOR); WriteReading(w); return w.GetLength(); }));
+
+  MQTTPayloadWriter json(scratch, sizeof(scratch), MQTT_PAYLOAD_JSON);
+  WriteReading(json);
+  Check(json.IsValid() && json.GetLength() == (uint16_t)sprintfLength && memcmp(scratch, data, sprintfLength) == 0, "writer JSON equals snprintf output");
+  Check(json.GetLength() == jsonSize.GetLength(), "sizing pass matches written length");
+  MQTTPayloadWriter small(scratch, 16, MQTT_PAYLOAD_JSON);
+  WriteReading(small);
+  Check(!small.IsValid() && small.GetLength() == jsonSize.GetLength(), "overflow detected, full length reported");
+
+  FakeEspConfig config;
+  config.jitter = 0;
+  const MQTTPayloadFormat formats[] = { MQTT_PAYLOAD_JSON, MQTT_PAYLOAD_CBOR };
+  for(uint8_t f = 0; f < 2; f++)
+  {
+    HostClock::Set(0);
+    FakeEsp esp(config);
+    EspDrv drv(&esp);
+    MQTTClient client(&drv, MessageReceived);
+    drv.Init(128);
+    MQTTConnectData connectData = { "broker.local", 1883, "sensor-1", NULL, NULL, NULL, 0, false, NULL, true, 60 };
+    client.Connect(connectData);
+    client.Subscribe(readingTopic, 0);
+    Idle(client, 200);
+    echoFormat = formats[f];
+    decoded = 0;
+    decodeErrors = 0;
+    unsigned long start = esp.dataTx;
+    for(unsigned long i = 0; i < readings; i++)
+    {
+      MQTTPayloadWriter payload = client.BeginPublish(readingTopic, formats[f]);
+      WriteReading(payload);
+      client.EndPublish(payload);
+      Idle(client, 100);
+    }
+    printf("%s over MQTT: %.1f B network per reading\n", formats[f] == MQTT_PAYLOAD_CBOR ? "CBOR" : "JSON",
+      (double)(esp.dataTx - start) / readings);
+    Check(decoded == readings && decodeErrors == 0, "echoes decoded in place");
+  }
+  return 0;
+}
@@ -0,0 +1,413 @@
+/*
+  Regression checks for fault paths of EspDrv and MQTTClient that the benchmarks do not hit,
+  run against FakeEsp with injected module output. See README.md.
+*/
+#include <string>
+#include "FakeEsp.h"
+#include "EspDrv.h"
+#include "MQTTClient.h"
+#include "MQTTReconnect.h"
+#include "MQTTScheduler.h"
+
+static const char* topic = "greenhouse/north/temperature";
+static const char* urcPayload = "x\r\nCLOSED\r\n\r\nSEND OK\r\ny";
+static unsigned long failures = 0;
+static unsigned long received = 0;
+static bool payloadIntact = false;
+
+static void MessageReceived(char* topic, uint8_t* payload, uint16_t length)
+{
+  received++;
+  payloadIntact = length == strlen(urcPayload) && memcmp(payload, urcPayload, length) == 0;
+}
+
+static MQTTClient* responder = nullptr;
+static std::string logPayload;
+static unsigned long replies = 0;
+static unsigned long logsIntact = 0;
+
+// Na příkaz odpoví publikováním přímo z callbacku, bez fronty příjmu
+static void RespondingReceived(char* topic, uint8_t* payload, uint16_t length)
+{
+  if(strcmp(topic, "gh/cmd") == 0)
+  {
+    responder->Publish("gh/reply", "ack");
+  }
+  else if(strcmp(topic, "gh/reply") == 0)
+  {
+    replies++;
+  }
+  else if(length == logPayload.size() && memcmp(payload, logPayload.data(), length) == 0)
+  {
+    logsIntact++;
+  }
+}
+
+static void Check(bool condition, const char* what)
+{
+  printf("%-48s %s\n", what, condition ? "ok" : "FAILED");
+  failures += condition ? 0 : 1;
+}
+
+static void Idle(MQTTClient& client, unsigned long ms)
+{
+  unsigned long t = millis();
+  while(millis() - t < ms)
+  {
+    client.Loop();
+  }
+}
+
+// Smyčka jako v low-power aplikaci: spí do nejbližšího termínu nebo příchodu dat z modulu
+static unsigned long SleepLoop(MQTTClient& client, FakeEsp& esp, unsigned long ms)
+{
+  unsigned long passes = 0;
+  uint64_t end = HostClock::Now() + (uint64_t)ms * 1000;
+  while(HostClock::Now() < end)
+  {
+    client.Loop();
+    passes++;
+    unsigned long wait = client.NextDeadline();
+    uint64_t now = HostClock::Now();
+    uint64_t wake = wait == DEADLINE_NONE ? end : now + (uint64_t)wait * 1000;
+    uint64_t arrival = esp.NextArrival();
+    wake = arrival < wake ? arrival : wake;
+    wake = wake < end ? wake : end;
+    if(wake > now)
+    {
+      HostClock::Set(wake);
+    }
+  }
+  return passes;
+}
+
+// +IPD ohlásí 20 B, dorazí jen začátek PUBLISH a hned za ním SEND OK
+static void TruncatedFrameBeforeSendOk()
+{
+  HostClock::Set(0);
+  FakeEspConfig espConfig;
+  espConfig.jitter = 0;
+  FakeEsp esp(espConfig);
+  EspDrv drv(&esp);
+  MQTTClient client(&drv, MessageReceived);
+  drv.Init(128);
+  MQTTConnectData connectData = { "broker.local", 1883, "gh-north", NULL, NULL, NULL, 0, false, NULL, true, 60 };
+  client.Connect(connectData);
+  Idle(client, 1100);
+  EspDrvStats before = drv.GetStats();
+  static const char frame[] = "\r\n+IPD,20:\x30\x12\x00\x05gh/t";
+  esp.beforeSendOk = std::string(frame, sizeof(frame) - 1);
+  unsigned long start = millis();
+  bool sent = client.Publish(topic, "21.5");
+  unsigned long elapsed = millis() - start;
+  const EspDrvStats& after = drv.GetStats();
+  Check(sent && elapsed < 200 && after.tagFailures == before.tagFailures && after.ipdResyncs == before.ipdResyncs + 1, "truncated +IPD before SEND OK resynced");
+}
+
+// Text URC v payloadu echa nesmí rámec ukončit ani vyvolat CLOSED
+static void UrcTextInPayload()
+{
+  HostClock::Set(0);
+  FakeEspConfig espConfig;
+  espConfig.jitter = 0;
+  FakeEsp esp(espConfig);
+  EspDrv drv(&esp);
+  MQTTClient client(&drv, MessageReceived);
+  drv.Init(128);
+  MQTTConnectData connectData = { "broker.local", 1883, "gh-north", NULL, NULL, NULL, 0, false, NULL, true, 60 };
+  client.Connect(connectData);
+  client.Subscribe(topic, 0);
+  Idle(client, 1100);
+  EspDrvStats before = drv.GetStats();
+  received = 0;
+  client.Publish(topic, urcPayload);
+  Idle(client, 200);
+  const EspDrvStats& after = drv.GetStats();
+  Check(received == 1 && payloadIntact && after.closed == before.closed && after.ipdResyncs == before.ipdResyncs, "URC text inside a payload delivered intact");
+}
+
+// Rámec větší než buffer od volajícího se přeskočí celý, jeho data nejsou výstup modulu
+static void FrameLargerThanCallerBuffer()
+{
+  HostClock::Set(0);
+  FakeEspConfig espConfig;
+  espConfig.jitter = 0;
+  FakeEsp esp(espConfig);
+  EspDrv drv(&esp);
+  MQTTClient client(&drv, MessageReceived);
+  static uint8_t receiveBuffer[48];
+  drv.SetReceiveBuffer(receiveBuffer, sizeof(receiveBuffer));
+  drv.Init(0);
+  MQTTConnectData connectData = { "broker.local", 1883, "gh-north", NULL, NULL, NULL, 0, false, NULL, true, 60 };
+  client.Connect(connectData);
+  client.Subscribe(topic, 0);
+  Idle(client, 1100);
+  EspDrvStats before = drv.GetStats();
+  received = 0;
+  client.Publish(topic, urcPayload);
+  Idle(client, 1100);
+  client.Publish(topic, "21.5");
+  Idle(client, 200);
+  const EspDrvStats& after = drv.GetStats();
+  Check(received == 1 && after.closed == before.closed && after.ipdDropped == before.ipdDropped + 1
+    && after.dataTimeouts == before.dataTimeouts, "frame larger than caller buffer skipped");
+}
+
+// Příkaz přijde mezi částmi dlouhé zprávy; callback na něj publikuje až po jejím zápisu
+static void CallbackPublishesDuringPacedSend()
+{
+  HostClock::Set(0);
+  FakeEspConfig espConfig;
+  espConfig.jitter = 0;
+  espConfig.rxBuffer = 64;
+  espConfig.timedWrite = true;
+  FakeEsp esp(espConfig);
+  EspDrv drv(&esp);
+  MQTTClientStatic<512> client(&drv, RespondingReceived);
+  responder = &client;
+  drv.Init(128);
+  drv.SetTxPacing(espConfig.baud, espConfig.rxBuffer);
+  MQTTConnectData connectData = { "broker.local", 1883, "gh-north", NULL, NULL, NULL, 0, false, NULL, true, 60 };
+  client.Connect(connectData);
+  client.Subscribe("gh/reply", 0);
+  client.Subscribe("gh/log", 0);
+  Idle(client, 1100);
+  EspDrvStats before = drv.GetStats();
+  static const char command[] = "\x30\x0A\x00\x06gh/cmdgo";
+  esp.midSend = std::string(command, sizeof(command) - 1);
+  logPayload.assign(300, 'l');
+  bool sent = client.Publish("gh/log", logPayload.c_str());
+  Idle(client, 200);
+  const EspDrvStats& after = drv.GetStats();
+  Check(sent && replies == 1 && logsIntact == 1 && after.ipdDeferred == before.ipdDeferred + 1
+    && after.tagFailures == before.tagFailures, "callback publish during paced send deferred");
+}
+
+// Termín kontroly stavu se neposouvá s každým průchodem Loop, platí od posledního dotazu
+static void StatusDeadlineDoesNotSlide()
+{
+  HostClock::Set(0);
+  FakeEspConfig espConfig;
+  espConfig.jitter = 0;
+  FakeEsp esp(espConfig);
+  EspDrv drv(&esp);
+  MQTTClient client(&drv, MessageReceived);
+  drv.Init(128);
+  MQTTConnectData connectData = { "broker.local", 1883, "gh-north", NULL, NULL, NULL, 0, false, NULL, true, 60 };
+  client.Connect(connectData);
+  SleepLoop(client, esp, 1000);
+  unsigned long first = client.NextDeadline();
+  HostClock::Set(HostClock::Now() + (uint64_t)(first / 2) * 1000);
+  client.Loop();
+  unsigned long second = client.NextDeadline();
+  Check(first <= ESP_STATUS_CACHE && second <= first - first / 2, "status deadline does not slide");
+}
+
+// Nečinné spojení v light-sleep modul nebudí dotazy na stav; pád spojení ohlásí CLOSED
+static void IdleLinkInLightSleep()
+{
+  HostClock::Set(0);
+  FakeEspConfig espConfig;
+  espConfig.jitter = 0;
+  FakeEsp esp(espConfig);
+  EspDrv drv(&esp);
+  MQTTClient client(&drv, MessageReceived);
+  drv.Init(128);
+  drv.SetLatencyBudget(200);
+  MQTTConnectData connectData = { "broker.local", 1883, "gh-north", NULL, NULL, NULL, 0, false, NULL, true, 60 };
+  client.Connect(connectData);
+  SleepLoop(client, esp, 1000);
+  unsigned long commands = esp.commands;
+  unsigned long wakeups = esp.wakeups;
+  unsigned long passes = SleepLoop(client, esp, 60000);
+  Check(drv.GetSleepMode() == ESP_SLEEP_LIGHT && passes <= 2 && esp.commands - commands <= 2
+    && esp.wakeups - wakeups <= 1, "idle link in light sleep not polled");
+  esp.Drop();
+  SleepLoop(client, esp, 300);
+  Check(!client.Loop(), "dropped link seen from CLOSED");
+}
+
+// Modul po probuzení odpoví pozdě: zopakovaný AT+CIPSEND by skončil v datech paketu
+static void LateReplyAfterWake()
+{
+  HostClock::Set(0);
+  FakeEspConfig espConfig;
+  espConfig.jitter = 0;
+  FakeEsp esp(espConfig);
+  EspDrv drv(&esp);
+  MQTTClient client(&drv, MessageReceived);
+  drv.Init(128);
+  drv.SetLatencyBudget(200);
+  MQTTConnectData connectData = { "broker.local", 1883, "gh-north", NULL, NULL, NULL, 0, false, NULL, true, 60 };
+  client.Connect(connectData);
+  client.Subscribe(topic, 0);
+  SleepLoop(client, esp, 1000);
+  received = 0;
+  payloadIntact = false;
+  unsigned long published = esp.published;
+  esp.wakeReplyDelay = 3000;
+  bool sent = client.Publish(topic, urcPayload);
+  esp.wakeReplyDelay = 0;
+  SleepLoop(client, esp, 5000);
+  Check(sent && esp.published == published + 1 && received == 1 && payloadIntact, "late reply after wake-up repeats only AT");
+}
+
+// CONNACK s nenulovým kódem je neúspěšné připojení, ne spojení bez relace
+static void ConnectRefused()
+{
+  HostClock::Set(0);
+  FakeEspConfig espConfig;
+  espConfig.jitter = 0;
+  FakeEsp esp(espConfig);
+  EspDrv drv(&esp);
+  MQTTClient client(&drv, MessageReceived);
+  drv.Init(128);
+  MQTTConnectData connectData = { "broker.local", 1883, "gh-north", NULL, NULL, NULL, 0, false, NULL, true, 60 };
+  esp.connackCode = 5;
+  bool refused = !client.Connect(connectData) && client.GetConnectReturnCode() == 5 && !client.Loop();
+  esp.connackCode = 0;
+  bool accepted = client.Connect(connectData) && client.GetConnectReturnCode() == MQTT_CONNACK_ACCEPTED;
+  Check(refused && accepted, "refused CONNACK fails the connect");
+}
+
+// Broker odmítá přihlášení: MQTTReconnect zkouší znovu s rostoucím odstupem, ne v každém průchodu
+static void ReconnectBacksOffWhenRefused()
+{
+  HostClock::Set(0);
+  FakeEspConfig espConfig;
+  espConfig.jitter = 0;
+  FakeEsp esp(espConfig);
+  EspDrv drv(&esp);
+  MQTTClient client(&drv, MessageReceived);
+  drv.Init(128);
+  MQTTConnectData connectData = { "broker.local", 1883, "gh-north", NULL, NULL, NULL, 0, false, NULL, true, 60 };
+  MQTTReconnect reconnect(&drv, &client, "host", "secret", connectData);
+  esp.connackCode = 5;
+  unsigned long start = millis();
+  bool connected = false;
+  // Průchody, po kterých zůstalo otevřené TCP spojení čekat na další pokus o přihlášení
+  unsigned long idleOpen = 0;
+  while(millis() - start < 30000)
+  {
+    connected = reconnect.Loop() || connected;
+    idleOpen += reconnect.GetLayer() == RECONNECT_MQTT ? 1 : 0;
+    delay(10);
+  }
+  unsigned long refused = esp.connects;
+  esp.connackCode = 0;
+  start = millis();
+  while(millis() - start < 130000 && !reconnect.Loop())
+  {
+    delay(10);
+  }
+  Check(!connected && refused >= 2 && refused <= 6 && idleOpen == 0 && reconnect.GetLayer() == RECONNECT_CONNECTED, "reconnect backs off while CONNECT is refused");
+}
+
+// Modul ohlásí +IPD s odpovědí dřív než SEND OK; RTT musí odpovídat síti, ne intervalu pingu
+static void ResponseBeforeSendOk()
+{
+  HostClock::Set(0);
+  FakeEspConfig espConfig;
+  espConfig.jitter = 0;
+  espConfig.latency = 5;
+  espConfig.sendDelay = 30;
+  FakeEsp esp(espConfig);
+  EspDrv drv(&esp);
+  MQTTClient client(&drv, MessageReceived);
+  drv.Init(128);
+  MQTTConnectData connectData = { "broker.local", 1883, "gh-north", NULL, NULL, NULL, 0, false, NULL, true, 10 };
+  client.Connect(connectData);
+  client.Subscribe(topic, 0);
+  // Odhad RTT je společný všem klientům, počítají se jen vzorky tohoto spojení
+  uint16_t samples = client.GetRtt().samples;
+  SleepLoop(client, esp, 60000);
+  const RttEstimator& rtt = client.GetRtt();
+  Check(client.Loop() && rtt.samples >= samples + 5 && rtt.srtt < espConfig.sendDelay, "RTT sampled when the response beats SEND OK");
+}
+
+// BUSY sníží rychlost na polovinu, CRITICAL předběhne frontu, po klidu se rychlost vrátí
+static void SchedulerPreemptsAndAdapts()
+{
+  HostClock::Set(0);
+  FakeEspConfig espConfig;
+  espConfig.jitter = 0;
+  FakeEsp esp(espConfig);
+  EspDrv drv(&esp);
+  MQTTClient client(&drv, MessageReceived);
+  drv.Init(128);
+  MQTTConnectData connectData = { "broker.local", 1883, "gh-north", NULL, NULL, NULL, 0, false, NULL, true, 60 };
+  client.Connect(connectData);
+  Idle(client, 1100);
+  static uint8_t storage[8 * 96];
+  MQTTScheduler scheduler(&drv, &client, storage, sizeof(storage), 96);
+  scheduler.SetRate(200, 100, 50, 400);
+  for(uint8_t i = 0; i < 6; i++)
+  {
+    scheduler.Publish("gh/log", "0123456789012345678901234567890123456789", SCHED_LOW);
+  }
+  scheduler.Loop();
+  uint8_t waiting = scheduler.GetQueued();
+  uint16_t rate = scheduler.GetRate();
+  esp.Inject("\r\nBUSY\r\n");
+  while(drv.GetStats().busy == 0 || drv.IsBusy())
+  {
+    client.Loop();
+  }
+  scheduler.Loop();
+  bool halved = scheduler.GetRate() == rate / 2 && scheduler.GetRateDecreases() == 1;
+  scheduler.Publish("gh/alarm", "smoke", SCHED_CRITICAL);
+  scheduler.Loop();
+  bool preempted = scheduler.GetStats(SCHED_CRITICAL).sent == 1 && scheduler.GetQueued() == waiting;
+  unsigned long start = millis();
+  while(millis() - start < 40000)
+  {
+    scheduler.Loop();
+    client.Loop();
+  }
+  Check(waiting > 0 && halved && preempted && scheduler.GetRate() >= rate && scheduler.GetQueued() == 0
+    && scheduler.GetStats(SCHED_LOW).sent == 6, "scheduler preempts and recovers from BUSY");
+}
+
+// Dlouhé vyprázdnění fronty v jednom Loop: tokeny přibývají během odesílání
+static void SchedulerRefillsDuringDrain()
+{
+  HostClock::Set(0);
+  FakeEspConfig espConfig;
+  espConfig.jitter = 0;
+  FakeEsp esp(espConfig);
+  EspDrv drv(&esp);
+  MQTTClient client(&drv, MessageReceived);
+  drv.Init(128);
+  MQTTConnectData connectData = { "broker.local", 1883, "gh-north", NULL, NULL, NULL, 0, false, NULL, true, 60 };
+  client.Connect(connectData);
+  Idle(client, 1100);
+  static uint8_t storage[8 * 96];
+  MQTTScheduler scheduler(&drv, &client, storage, sizeof(storage), 96);
+  // Bucket pojme jednu zprávu, jedno odeslání trvá déle, než se doplní
+  scheduler.SetRate(4000, 80, 50, 4000);
+  for(uint8_t i = 0; i < 5; i++)
+  {
+    scheduler.Publish("gh/log", "0123456789012345678901234567890123456789", SCHED_LOW);
+  }
+  uint8_t sent = scheduler.Loop();
+  Check(sent == 5, "scheduler refills tokens while draining");
+}
+
+int main(int argc, char** argv)
+{
+  Serial.quiet = getenv("VERBOSE") == nullptr;
+  randomSeed(1);
+  TruncatedFrameBeforeSendOk();
+  UrcTextInPayload();
+  FrameLargerThanCallerBuffer();
+  CallbackPublishesDuringPacedSend();
+  StatusDeadlineDoesNotSlide();
+  IdleLinkInLightSleep();
+  LateReplyAfterWake();
+  ConnectRefused();
+  ReconnectBacksOffWhenRefused();
+  ResponseBeforeSendOk();
+  SchedulerPreemptsAndAdapts();
+  SchedulerRefillsDuringDrain();
+  return failures > 0 ? 1 : 0;
+}
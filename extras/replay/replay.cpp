@@ -0,0 +1,327 @@
+/*
+  Replays EspTraceStream captures through EspDrv::Loop and the MQTT decoder under a virtual clock.
+  See README.md for the build command and the capture format.
+*/
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include "EspDrv.h"
+#include "MQTTClient.h"
+
+struct TraceRecord
+{
+  uint64_t time;
+  std::vector<uint8_t> bytes;
+};
+
+// Stream, ve kterém jsou přijaté byty k dispozici až v čase svého příchodu
+class ReplayStream : public Stream
+{
+  public:
+    std::vector<TraceRecord> records;
+    size_t record = 0;
+    size_t offset = 0;
+    uint32_t byteTime = 174;
+    bool events = false;
+    bool hold = false;
+    std::string tx;
+
+    uint64_t Arrival()
+    {
+      return records[record].time + (uint64_t)offset * byteTime;
+    }
+
+    bool Exhausted()
+    {
+      return record >= records.size();
+    }
+
+    int available()
+    {
+      if(hold)
+      {
+        return 0;
+      }
+      int count = 0;
+      size_t r = record;
+      size_t o = offset;
+      uint64_t now = HostClock::Now();
+      while(r < records.size() && records[r].time + (uint64_t)o * byteTime <= now && count < 64)
+      {
+        count++;
+        if(++o == records[r].bytes.size())
+        {
+          r++;
+          o = 0;
+        }
+      }
+      return count;
+    }
+
+    int peek()
+    {
+      return available() ? records[record].bytes[offset] : -1;
+    }
+
+    int read()
+    {
+      if(!available())
+      {
+        return -1;
+      }
+      uint8_t b = records[record].bytes[offset];
+      if(++offset == records[record].bytes.size())
+      {
+        record++;
+        offset = 0;
+      }
+      return b;
+    }
+
+    size_t write(uint8_t b)
+    {
+      if(b == '\n')
+      {
+        if(events)
+        {
+          printf("%10lu TX %s\n", (unsigned long)(HostClock::Now() / 1000), tx.c_str());
+        }
+        tx.clear();
+      }
+      else if(b >= 32 && b <= 126)
+      {
+        tx += (char)b;
+      }
+      else if(b != '\r')
+      {
+        char hex[5];
+        snprintf(hex, sizeof(hex), "<%02X>", b);
+        tx += hex;
+      }
+      return 1;
+    }
+    using Print::write;
+};
+
+static const char* packetNames[16] = { "RESERVED", "CONNECT", "CONNACK", "PUBLISH", "PUBACK", "PUBREC", "PUBREL", "PUBCOMP",
+  "SUBSCRIBE", "SUBACK", "UNSUBSCRIBE", "UNSUBACK", "PINGREQ", "PINGRESP", "DISCONNECT", "RESERVED" };
+static unsigned long packetCounts[16];
+static unsigned long publishCount = 0;
+static unsigned long payloadBytes = 0;
+static bool eventsEnabled = false;
+static void (*mqttDataReceived)(uint8_t* buffer, int length) = nullptr;
+
+static void CountingDataReceived(uint8_t* buffer, int length)
+{
+  uint8_t type = buffer[0] >> 4;
+  packetCounts[type]++;
+  if(eventsEnabled)
+  {
+    printf("%10lu RX %s length %d\n", (unsigned long)(HostClock::Now() / 1000), packetNames[type], length);
+  }
+  mqttDataReceived(buffer, length);
+}
+
+static void MessageReceived(char* topic, uint8_t* payload, uint16_t length)
+{
+  publishCount++;
+  payloadBytes += length;
+  if(eventsEnabled)
+  {
+    printf("%10lu MSG %s length %u\n", (unsigned long)(HostClock::Now() / 1000), topic, length);
+  }
+}
+
+static bool LoadTrace(const char* path, ReplayStream& stream)
+{
+  std::ifstream file(path);
+  if(!file)
+  {
+    fprintf(stderr, "Cannot open %s\n", path);
+    return false;
+  }
+  std::string line;
+  unsigned long lineNumber = 0;
+  while(std::getline(file, line))
+  {
+    lineNumber++;
+    if(line.empty() || line[0] == '#' || line[0] == '\r')
+    {
+      continue;
+    }
+    std::istringstream in(line);
+    std::string direction;
+    unsigned long time;
+    std::string hex;
+    if(!(in >> direction >> time >> hex) || hex.size() % 2 != 0)
+    {
+      fprintf(stderr, "%s:%lu: malformed record\n", path, lineNumber);
+      return false;
+    }
+    if(direction != "R")
+    {
+      continue;
+    }
+    TraceRecord record;
+    record.time = (uint64_t)time * 1000;
+    for(size_t i = 0; i < hex.size(); i += 2)
+    {
+      record.bytes.push_back((uint8_t)strtoul(hex.substr(i, 2).c_str(), nullptr, 16));
+    }
+    // Záznamy se stejným časem se řadí za sebe
+    if(!stream.records.empty() && record.time < stream.records.back().time)
+    {
+      record.time = stream.records.back().time;
+    }
+    stream.records.push_back(record);
+  }
+  return true;
+}
+
+static void Usage()
+{
+  fprintf(stderr, "usage: espreplay [--baud N] [--tick US] [--events] [--verbose] capture...\n");
+}
+
+static int Replay(const char* path, unsigned long baud, uint32_t tick)
+{
+  ReplayStream stream;
+  stream.events = eventsEnabled;
+  stream.byteTime = (uint32_t)(10000000UL / baud);
+  if(!LoadTrace(path, stream))
+  {
+    return 1;
+  }
+  memset(packetCounts, 0, sizeof(packetCounts));
+  publishCount = 0;
+  payloadBytes = 0;
+
+  HostClock::Set(0);
+  HostClock::SetTick(tick);
+  randomSeed(1);
+  EspDrv drv(&stream);
+  MQTTClient client(&drv, MessageReceived);
+  mqttDataReceived = drv.DataReceived;
+  drv.DataReceived = CountingDataReceived;
+  // Init bez dat jen alokuje buffer (ATE0 vyprší), pak začíná záznam
+  stream.hold = true;
+  stream.events = false;
+  drv.Init(128);
+  stream.events = eventsEnabled;
+  stream.hold = false;
+  EspDrvStats base = drv.GetStats();
+
+  if(stream.records.empty())
+  {
+    printf("%s: empty capture\n", path);
+    return 0;
+  }
+  uint64_t start = stream.records[0].time;
+  HostClock::Set(max(HostClock::Now(), start));
+  uint64_t virtualStart = HostClock::Now();
+  std::chrono::nanoseconds cpu(0);
+  while(true)
+  {
+    if(!stream.available())
+    {
+      if(stream.Exhausted())
+      {
+        break;
+      }
+      if(stream.Arrival() > HostClock::Now())
+      {
+        HostClock::Set(stream.Arrival());
+      }
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    drv.Loop();
+    cpu += std::chrono::steady_clock::now() - t0;
+  }
+  // Nechá doběhnout rozpracované timeouty
+  HostClock::Advance(5000000);
+  drv.Loop();
+
+  const EspDrvStats& s = drv.GetStats();
+  unsigned long rxBytes = s.rxBytes - base.rxBytes;
+  unsigned long packets = 0;
+  for(int i = 0; i < 16; i++)
+  {
+    packets += packetCounts[i];
+  }
+  printf("capture         %s\n", path);
+  printf("duration        %lu ms (virtual)\n", (unsigned long)((HostClock::Now() - virtualStart) / 1000));
+  printf("rx bytes        %lu\n", rxBytes);
+  printf("+IPD frames     %u (delivered %u, dropped %u)\n", s.ipdFrames - base.ipdFrames, s.ipdDelivered - base.ipdDelivered, s.ipdDropped - base.ipdDropped);
+  printf("MQTT packets    %lu", packets);
+  for(int i = 0; i < 16; i++)
+  {
+    if(packetCounts[i] > 0)
+    {
+      printf(" %s=%lu", packetNames[i], packetCounts[i]);
+    }
+  }
+  printf("\n");
+  printf("messages        %lu (%lu payload bytes)\n", publishCount, payloadBytes);
+  printf("framing         resyncs %u, length errors %u, coalesced %u\n", s.ipdResyncs - base.ipdResyncs, s.ipdLengthErrors - base.ipdLengthErrors, s.ipdCoalesced - base.ipdCoalesced);
+  printf("tags            recognized %u, failed %u\n", s.tagsRecognized - base.tagsRecognized, s.tagFailures - base.tagFailures);
+  printf("URC             STATUS %u, CLOSED %u, BUSY %u\n", s.statusLines - base.statusLines, s.closed - base.closed, s.busy - base.busy);
+  printf("timeouts        data %u, status %u, busy %u\n", s.dataTimeouts - base.dataTimeouts, s.statusTimeouts - base.statusTimeouts, s.busyTimeouts - base.busyTimeouts);
+  printf("cpu             %.1f ns/byte (host)\n", rxBytes == 0 ? 0.0 : (double)cpu.count() / rxBytes);
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  unsigned long baud = 57600;
+  uint32_t tick = 10;
+  bool verbose = false;
+  std::vector<const char*> captures;
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if(arg == "--baud" && i + 1 < argc)
+    {
+      baud = strtoul(argv[++i], nullptr, 10);
+    }
+    else if(arg == "--tick" && i + 1 < argc)
+    {
+      tick = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    }
+    else if(arg == "--events")
+    {
+      eventsEnabled = true;
+    }
+    else if(arg == "--verbose")
+    {
+      verbose = true;
+    }
+    else if(arg[0] == '-')
+    {
+      Usage();
+      return 2;
+    }
+    else
+    {
+      captures.push_back(argv[i]);
+    }
+  }
+  if(captures.empty() || baud == 0)
+  {
+    Usage();
+    return 2;
+  }
+  Serial.quiet = !verbose;
+  int result = 0;
+  for(size_t i = 0; i < captures.size(); i++)
+  {
+    if(i > 0)
+    {
+      printf("\n");
+    }
+    result |= Replay(captures[i], baud, tick);
+  }
+  return result;
+}
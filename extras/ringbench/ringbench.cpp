@@ -0,0 +1,135 @@
+/*
+  Exercises EspRxRing with a producer thread (UART RX interrupt) and a consumer thread (EspDrv::Loop).
+
+  g++ -std=gnu++11 -O2 -pthread -I extras/host -I src extras/ringbench/ringbench.cpp extras/host/HostArduino.cpp -o ringbench
+  ./ringbench [--size N] [--bytes N] [--rate BYTES_PER_S] [--stall-every N] [--stall-us US]
+
+  Without --rate the producer waits for free space and the raw ring throughput is measured.
+  The consumer stalls for --stall-us every --stall-every bytes to model a slow callback.
+  Bytes carry a running sequence, so lost or reordered bytes are detected.
+*/
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Arduino.h>
+#include "EspRxRing.h"
+
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char** argv)
+{
+  unsigned long size = 64;
+  unsigned long bytes = 10000000;
+  unsigned long rate = 0;
+  unsigned long stallEvery = 0;
+  unsigned long stallUs = 0;
+  for(int i = 1; i + 1 < argc; i += 2)
+  {
+    std::string arg = argv[i];
+    unsigned long value = strtoul(argv[i + 1], nullptr, 10);
+    if(arg == "--size") size = value;
+    else if(arg == "--bytes") bytes = value;
+    else if(arg == "--rate") rate = value;
+    else if(arg == "--stall-every") stallEvery = value;
+    else if(arg == "--stall-us") stallUs = value;
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  if(!EspRxRing::ValidSize((uint16_t)size))
+  {
+    fprintf(stderr, "--size must be a power of two between 2 and 256\n");
+    return 2;
+  }
+
+  std::vector<uint8_t> storage(size);
+  EspRxRing ring(storage.data(), (uint16_t)size);
+  std::atomic<bool> done(false);
+  unsigned long pushed = 0;
+
+  Clock::time_point start = Clock::now();
+  std::thread producer([&]()
+  {
+    for(unsigned long i = 0; i < bytes; i++)
+    {
+      if(rate > 0)
+      {
+        // UART: další byte přijde až ve svém čase
+        Clock::time_point due = start + std::chrono::nanoseconds((uint64_t)i * 1000000000ULL / rate);
+        while(Clock::now() < due)
+        {
+        }
+      }
+      if(rate == 0)
+      {
+        // Bez omezení rychlosti se měří propustnost, producent čeká na místo
+        while(!ring.Push((uint8_t)i))
+        {
+          std::this_thread::yield();
+        }
+        pushed++;
+      }
+      else if(ring.Push((uint8_t)i))
+      {
+        pushed++;
+      }
+    }
+    done = true;
+  });
+
+  unsigned long popped = 0;
+  unsigned long sequenceErrors = 0;
+  unsigned long batches = 0;
+  uint8_t expected = 0;
+  bool first = true;
+  std::thread consumer([&]()
+  {
+    while(true)
+    {
+      bool finished = done;
+      uint8_t batch = ring.Available();
+      if(batch == 0)
+      {
+        if(finished)
+        {
+          break;
+        }
+        std::this_thread::yield();
+        continue;
+      }
+      batches++;
+      while(batch--)
+      {
+        uint8_t b = (uint8_t)ring.Pop();
+        // Po přetečení chybí byty, sekvence se znovu synchronizuje
+        if(!first && b != expected)
+        {
+          sequenceErrors++;
+        }
+        first = false;
+        expected = b + 1;
+        popped++;
+        if(stallEvery > 0 && popped % stallEvery == 0)
+        {
+          std::this_thread::sleep_for(std::chrono::microseconds(stallUs));
+        }
+      }
+    }
+  });
+  producer.join();
+  consumer.join();
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  printf("ring size       %lu (capacity %u)\n", size, ring.Capacity());
+  printf("bytes           produced %lu, pushed %lu, consumed %lu\n", bytes, pushed, popped);
+  printf(rate == 0 ? "full waits      %u\n" : "overruns        %u\n", ring.GetOverruns());
+  printf("sequence gaps   %lu\n", sequenceErrors);
+  printf("high water      %u\n", ring.GetHighWater());
+  printf("batches         %lu (%.1f bytes/batch)\n", batches, batches == 0 ? 0.0 : (double)popped / batches);
+  printf("throughput      %.2f MB/s\n", popped / seconds / 1e6);
+  return pushed == popped ? 0 : 1;
+}
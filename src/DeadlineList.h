@@ -0,0 +1,79 @@
+#ifndef __DEADLINELIST_H
+#define __DEADLINELIST_H
+
+#include <Arduino.h>
+
+// NextDeadline(): žádná časovaná akce není naplánovaná
+#define DEADLINE_NONE 0xFFFFFFFFUL
+
+/*
+  Časovače seřazené podle termínu (millis), nejbližší je první. Každé id je v seznamu nejvýš jednou,
+  Set ho přeplánuje. Porovnání snese přetečení millis().
+*/
+template<uint8_t Capacity>
+class DeadlineList
+{
+  private:
+    uint8_t ids[Capacity];
+    unsigned long deadlines[Capacity];
+    uint8_t count = 0;
+
+  public:
+    void Set(uint8_t id, unsigned long deadline)
+    {
+      Cancel(id);
+      if(count == Capacity)
+      {
+        return;
+      }
+      uint8_t i = count++;
+      while(i > 0 && (long)(deadlines[i - 1] - deadline) > 0)
+      {
+        ids[i] = ids[i - 1];
+        deadlines[i] = deadlines[i - 1];
+        i--;
+      }
+      ids[i] = id;
+      deadlines[i] = deadline;
+    }
+
+    void Cancel(uint8_t id)
+    {
+      for(uint8_t i = 0; i < count; i++)
+      {
+        if(ids[i] == id)
+        {
+          count--;
+          for(; i < count; i++)
+          {
+            ids[i] = ids[i + 1];
+            deadlines[i] = deadlines[i + 1];
+          }
+          return;
+        }
+      }
+    }
+
+    bool Empty()
+    {
+      return count == 0;
+    }
+
+    uint8_t FirstId()
+    {
+      return ids[0];
+    }
+
+    // Čas do nejbližšího termínu, 0 pokud už nastal
+    unsigned long Remaining(unsigned long now)
+    {
+      if(count == 0)
+      {
+        return DEADLINE_NONE;
+      }
+      long diff = (long)(deadlines[0] - now);
+      return diff > 0 ? (unsigned long)diff : 0;
+    }
+};
+
+#endif
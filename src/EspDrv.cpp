@@ -36,6 +36,67 @@
   #define PRINT_ERROR(x)
 #endif
 
+struct EspCmdInfo
+{
+  const char* text;
+  const char* tag;
+  uint16_t timeout;
+  uint16_t minTimeout;
+  uint16_t maxTimeout;
+  uint8_t slot;
+  // Smí se po probuzení poslat znovu: nemá vedlejší účinek (ne CIPSTART, CIPSEND, CWJAP, RST)
+  bool repeatable;
+};
+
+static const char tagOk[] = "OK";
+static const char tagPrompt[] = ">";
+
+// %d celé číslo, %s řetězec, %q řetězec v uvozovkách (escapovaný)
+static const char cmdAt[] PROGMEM = "AT";
+static const char cmdAte0[] PROGMEM = "ATE0";
+static const char cmdRst[] PROGMEM = "AT+RST";
+static const char cmdCwmodeStation[] PROGMEM = "AT+CWMODE=1";
+static const char cmdCwautoconn[] PROGMEM = "AT+CWAUTOCONN=%d";
+static const char cmdCwjap[] PROGMEM = "AT+CWJAP_%s=%q,%q";
+static const char cmdCwjapBssid[] PROGMEM = "AT+CWJAP_%s=%q,%q,%q";
+static const char cmdCwjapQuery[] PROGMEM = "AT+CWJAP_CUR?";
+static const char cmdCwqap[] PROGMEM = "AT+CWQAP";
+static const char cmdCipmuxSingle[] PROGMEM = "AT+CIPMUX=0";
+static const char cmdCipstartTcp[] PROGMEM = "AT+CIPSTART=\"TCP\",%q,%d";
+static const char cmdCipstartUdp[] PROGMEM = "AT+CIPSTART=\"UDP\",%q,%d,%d,0";
+static const char cmdCipdomain[] PROGMEM = "AT+CIPDOMAIN=%q";
+static const char cmdCipsend[] PROGMEM = "AT+CIPSEND=%d";
+static const char cmdCipstatus[] PROGMEM = "AT+CIPSTATUS";
+static const char cmdCipclose[] PROGMEM = "AT+CIPCLOSE";
+static const char cmdSleep[] PROGMEM = "AT+SLEEP=%d";
+static const char cmdWakeupGpio[] PROGMEM = "AT+WAKEUPGPIO=1,%d,0";
+
+// Pořadí odpovídá enum EspCmd. Výchozí timeout platí do prvního měření,
+// pak srtt + 4 * rttvar v mezích <min, max>.
+static const EspCmdInfo espCmds[] PROGMEM =
+{
+  { cmdAt, tagOk, 1000, 100, 3000, ESP_LAT_LOCAL, true },
+  { cmdAte0, tagOk, 1000, 100, 3000, ESP_LAT_LOCAL, true },
+  { cmdAte0, tagOk, 10000, 10000, 10000, ESP_LAT_NONE, true },
+  { cmdRst, tagOk, 30000, 30000, 30000, ESP_LAT_NONE, false },
+  { cmdCwmodeStation, tagOk, 1000, 100, 3000, ESP_LAT_LOCAL, true },
+  { cmdCwautoconn, tagOk, 1000, 100, 3000, ESP_LAT_LOCAL, true },
+  { cmdCwjap, tagOk, 10000, 10000, 10000, ESP_LAT_NONE, false },
+  { cmdCwjapBssid, tagOk, 10000, 10000, 10000, ESP_LAT_NONE, false },
+  { cmdCwjapQuery, tagOk, 1000, 100, 3000, ESP_LAT_LOCAL, true },
+  { cmdCwqap, tagOk, 1000, 100, 3000, ESP_LAT_LOCAL, true },
+  { cmdCipmuxSingle, tagOk, 10000, 100, 10000, ESP_LAT_LOCAL, true },
+  { cmdCipstartTcp, tagOk, 10000, 1000, 20000, ESP_LAT_START, false },
+  { cmdCipstartUdp, tagOk, 10000, 1000, 20000, ESP_LAT_START, false },
+  { cmdCipdomain, tagOk, 10000, 1000, 20000, ESP_LAT_DOMAIN, true },
+  { cmdCipsend, tagPrompt, 1000, 100, 5000, ESP_LAT_PROMPT, false },
+  { cmdCipstatus, tagOk, 1000, 100, 3000, ESP_LAT_STATUS, true },
+  { cmdCipclose, tagOk, 1000, 100, 5000, ESP_LAT_CLOSE, false },
+  { cmdSleep, tagOk, 1000, 100, 3000, ESP_LAT_LOCAL, true },
+  { cmdWakeupGpio, tagOk, 1000, 100, 3000, ESP_LAT_LOCAL, true }
+};
+static_assert(sizeof(espCmds) / sizeof(espCmds[0]) == CMD_COUNT, "espCmds must match EspCmd");
+
 EspDrv::EspDrv(Stream* serial) 
 {
   this->serial = serial;
@@ -72,18 +133,37 @@ void EspDrv::CheckTimeout()
         PRINTLN_WARNING(F("Status timout expired."));
         this->state = EspReadState::IDLE;
         statusCounter = 0;
+        stats.statusTimeouts++;
       }
     break;
     case EspReadState::DATA:
     case EspReadState::DATA_LENGTH:
-      if(millis() - startDataReadMillis > 3000)
+    case EspReadState::SKIP:
+      // Modul posílá rámec +IPD vcelku, mezera mezi byty znamená ztracená data.
+      // Byty čekající v UARTu (Loop nebyl dlouho volán) se ještě dočtou.
+      if(millis() - startDataReadMillis > ESP_DATA_GAP_TIMEOUT && RxAvailable() == 0)
       {
+        // Uvnitř rámce se URC nehledají, stejný text může být v payloadu. Rámec, který skončil
+        // výstupem modulu, přišel o byty a výstup se zpracuje až teď.
+        const char* urc = this->state == EspReadState::DATA ? FindUrc() : nullptr;
+        if(urc != nullptr)
+        {
+          ResyncFrame(urc);
+          break;
+        }
         PRINTLN_WARNING(F("Data timout expired."));
         this->state = EspReadState::IDLE;
         dataRead = 0;
         receivedDataLength = 0;
-        ResetBuffer(receivedDataBuffer, receivedDataBufferSize);
-        this->DataTimeout();
+        if(!framePending)
+        {
+          ResetBuffer(receivedDataBuffer, receivedDataBufferSize);
+        }
+        stats.dataTimeouts++;
+        if(this->DataTimeout != nullptr)
+        {
+          this->DataTimeout();
+        }
       }
     break;
     case EspReadState::BUSY:
@@ -91,22 +171,67 @@ void EspDrv::CheckTimeout()
       {
         PRINTLN_WARNING(F("Busy timout expired."));
         this->state = EspReadState::IDLE;
+        stats.busyTimeouts++;
+      }
+    break;
+    case EspReadState::CAPTURE:
+      if(millis() - captureTimer > 1000)
+      {
+        PRINTLN_WARNING(F("Capture timout expired."));
+        this->state = EspReadState::IDLE;
+        captureTag = nullptr;
       }
     break;
+    case EspReadState::IDLE:
+    break;
+  }
+}
+
+void EspDrv::SetRxRing(EspRxRing* ring)
+{
+  this->rxRing = ring;
+}
+
+void EspDrv::PumpRx()
+{
+  // Volá se z časovače, pokud UART nemá vlastní přerušení pro ring; jiný producent nesmí běžet
+  while(this->rxRing != nullptr && this->serial->available())
+  {
+    this->rxRing->Push((uint8_t)this->serial->read());
+  }
+}
+
+uint8_t EspDrv::RxAvailable()
+{
+  // Do ringu plní jen přerušení (UART nebo PumpRx z časovače), Loop je jediný konzument
+  if(this->rxRing != nullptr)
+  {
+    return this->rxRing->Available();
   }
+  int available = this->serial->available();
+  return available > 255 ? 255 : available;
+}
+
+int EspDrv::RxRead()
+{
+  return this->rxRing != nullptr ? this->rxRing->Pop() : this->serial->read();
 }
 
 void EspDrv::Loop() 
 {
   CheckTimeout();
-  while (this->serial->available()) 
+  // Byty se zpracují po dávkách, počet dostupných se zjišťuje jednou na dávku
+  uint8_t batch = 0;
+  while (batch > 0 || (batch = RxAvailable()) > 0) 
   {
+    batch--;
     CheckTimeout();
-    int raw = this->serial->read();
+    int raw = RxRead();
     if(raw == -1)
     {
       continue;
     }
+    stats.rxBytes++;
     #if TRACE
     if((raw >= 32 && raw <= 126) || raw == 13 || raw == 10)
     {
@@ -151,6 +276,7 @@ void EspDrv::Loop()
           {
             statusTimer = millis();
             statusCounter = 0;
+            Arm(ESP_TIMER_STATUS, statusTimer, 1000);
           }
           dataRead = 0;
           receivedDataLength = 0;
@@ -159,19 +285,36 @@ void EspDrv::Loop()
         }
         if (c == ':') 
         {
-          receivedDataBuffer[dataRead++] = '\0';
-          int result = sscanf(receivedDataBuffer, "%d", &receivedDataLength);
           PRINT_DEBUG("Data length ");
           PRINTLN_DEBUG(receivedDataLength);
-          if(result != 1 || receivedDataLength <= 0 || receivedDataLength > 512)
+          if(dataRead == 0 || receivedDataLength <= 0 || receivedDataLength > 512)
           {
+            stats.ipdDropped++;
             dataRead = 0;
             receivedDataLength = 0;
-            ResetBuffer(receivedDataBuffer, receivedDataBufferSize);
             this->state = this->lastState;
             continue;
           }
           dataRead = 0;
+          if(framePending)
+          {
+            // Buffer drží rámec odložený do konce zápisu dat, další rámec se zahodí
+            stats.ipdDropped++;
+            startDataReadMillis = millis();
+            this->state = EspReadState::SKIP;
+            continue;
+          }
+          if(receivedDataBufferSize < receivedDataLength && !ownsReceivedDataBuffer)
+          {
+            // Buffer od volajícího se nezvětšuje, rámec se zahodí i s daty
+            PRINT_ERROR(F("Data buffer too small: "));
+            PRINTLN_ERROR(receivedDataLength);
+            stats.ipdDropped++;
+            ResetBuffer(receivedDataBuffer, receivedDataBufferSize);
+            startDataReadMillis = millis();
+            this->state = EspReadState::SKIP;
+            continue;
+          }
           if(receivedDataBufferSize < receivedDataLength)
           {
             PRINT_DEBUG(F("Need data buffer allocation. Current size: "));
@@ -186,9 +329,11 @@ void EspDrv::Loop()
               PRINT_ERROR(F(". Current size: "));
               PRINTLN_ERROR(receivedDataBufferSize);
               memAllocFailCount = memAllocFailCount == 255? memAllocFailCount : memAllocFailCount + 1;              
+              stats.ipdDropped++;
               ResetBuffer(receivedDataBuffer, receivedDataBufferSize);
               dataRead = 0;
-              this->state = EspReadState::IDLE;
+              startDataReadMillis = millis();
+              this->state = EspReadState::SKIP;
               continue;
             }
             else
@@ -202,28 +347,46 @@ void EspDrv::Loop()
           startDataReadMillis = millis();
           ResetBuffer(receivedDataBuffer, receivedDataBufferSize);
           dataRead = 0;
+          frameCount++;
           this->state = EspReadState::DATA;
         } 
         else 
         {
-          if(c >= '0' && c <= '9')
+          // Délka se počítá bez bufferu, ten může držet odložený rámec
+          if(c >= '0' && c <= '9' && receivedDataLength <= 512)
           {
-            this->receivedDataBuffer[dataRead++] = c;
+            receivedDataLength = receivedDataLength * 10 + (c - '0');
+            dataRead++;
           }
         }
       break;
       case EspReadState::DATA:
         receivedDataBuffer[dataRead++] = (uint8_t)raw;
         startDataReadMillis = millis();
+        if(dataRead == 1 && !IsFrameStart((uint8_t)raw))
+        {
+          // Začátek rámce chybí, zbytek se zpracuje jako běžný výstup modulu
+          ResyncFrame(nullptr);
+          break;
+        }
         if (dataRead == receivedDataLength) 
         {
           PRINTLN_DEBUG(F("Read all received data."));
-          DataReceived(receivedDataBuffer, receivedDataLength);
+          this->state = busyTryCount > 0? EspReadState::BUSY : EspReadState::IDLE;
+          // Callback může přes Write číst další rámec do stejného bufferu, stav se uvolní předem
+          uint16_t length = receivedDataLength;
           dataRead = 0;
           receivedDataLength = 0;
-          ResetBuffer(receivedDataBuffer, receivedDataBufferSize);
           statusRead = millis();
-          this->state = busyTryCount > 0? EspReadState::BUSY : EspReadState::IDLE;
+          if(holdFrames)
+          {
+            // Callback by přepsal rozesílaná data nebo poslal příkaz do otevřeného CIPSEND
+            pendingLength = length;
+            framePending = true;
+            stats.ipdDeferred++;
+            continue;
+          }
+          DeliverFrame(length);
           continue;
         }
         PRINT_TRACE(F("Read "));
@@ -231,105 +394,468 @@ void EspDrv::Loop()
         PRINT_TRACE(F("/"));
         PRINTLN_TRACE(receivedDataLength);
       break;
-    }
-    if(c >= 32 && c <= 126)
-    {
-      ringBuffer[ringBufferTail] = c;
-      ringBufferTail = (ringBufferTail + 1) % ringBufferLength;
-    }
-    if((this->state == EspReadState::IDLE || this->state == EspReadState::BUSY) && this->expectedTag != nullptr)
-    {
-      if (CompareRingBuffer(this->expectedTag) == 0) 
-      {
-        PRINT_DEBUG(F("Tag recognized "));
-        PRINTLN_DEBUG(this->expectedTag);
-        TagReceived(this->expectedTag);
-        this->expectedTag = nullptr;
-        if(this->state == EspReadState::BUSY)
+      case EspReadState::SKIP:
+        // Data rámce se nesmí zpracovat jako výstup modulu
+        startDataReadMillis = millis();
+        if(++dataRead == receivedDataLength)
         {
-          busyTimeout = 0;
-          busyTryCount = 0;
+          dataRead = 0;
+          receivedDataLength = 0;
+          this->state = busyTryCount > 0? EspReadState::BUSY : EspReadState::IDLE;
+        }
+        continue;
+      case EspReadState::CAPTURE:
+        if(c == '\r' || c == '\n')
+        {
+          captureBuffer[captureLength] = '\0';
+          captureTag = nullptr;
           this->state = EspReadState::IDLE;
         }
-        return;
-      } 
+        else if(c != '"' && c >= 32 && c <= 126 && captureLength < captureSize - 1)
+        {
+          captureBuffer[captureLength++] = c;
+        }
+        continue;
+      case EspReadState::IDLE:
+      case EspReadState::BUSY:
+        // Výstup modulu se hledá v ringu
+      break;
     }
-    if (CompareRingBuffer("+IPD,") == 0) 
+    // Bez nového znaku by se znovu našel tag, který už byl zpracován (např. "OK" před dalším "\r\n")
+    if(!RingPush(c))
     {
-      PRINTLN_DEBUG(F("+IPD"));
-      ringBufferTail = (ringBufferTail - 5 + ringBufferLength) % ringBufferLength;
-      dataRead = 0;
-      startDataReadMillis = millis();
-      this->lastState = this->state;
-      this->state = EspReadState::DATA_LENGTH;
+      continue;
     }
-    else if (CompareRingBuffer("STATUS:") == 0 && (this->state == EspReadState::IDLE || this->state == EspReadState::BUSY) && !statusFound) 
+    if(MatchRing())
     {
-      PRINTLN_DEBUG(F("STATUS"));
-      statusTimer = millis();
-      statusCounter = 0;
-      statusFound = true;
-      busyTimeout = 0;
-      busyTryCount = 0;
-      this->state = EspReadState::STATUS;
+      return;
     }
-    else if (CompareRingBuffer("CLOSED") == 0 && (this->state == EspReadState::IDLE || this->state == EspReadState::BUSY)) 
+  }
+  // Termín příjmu dat se posouvá s každým bytem, přeplánuje se jednou za dávku.
+  // Do BUSY se vrací i po +IPD, proto se jeho termín obnovuje také zde.
+  if(this->state == EspReadState::DATA || this->state == EspReadState::DATA_LENGTH || this->state == EspReadState::SKIP)
+  {
+    Arm(ESP_TIMER_DATA, startDataReadMillis, ESP_DATA_GAP_TIMEOUT);
+  }
+  else if(this->state == EspReadState::BUSY)
+  {
+    Arm(ESP_TIMER_BUSY, busyTime, busyTimeout);
+  }
+  // Mimo příkaz a po mezeře za odesláním dat, SendCmd tu nesmí čekat
+  if(sleepMode == ESP_SLEEP_LIGHT && !asleep && commandDepth == 0 && this->state == EspReadState::IDLE
+    && millis() - lastCommand > ESP_SLEEP_REARM_IDLE && millis() - lastDataSend >= sendGap)
+  {
+    RearmSleep();
+  }
+}
+
+// Výstupy modulu, které uvnitř dat +IPD znamenají, že rámec přišel o byty
+static const char* const urcSignatures[] = { "\r\n+IPD,", "\r\nSEND OK\r\n", "\r\nCLOSED\r\n", "\r\nERROR\r\n" };
+
+bool EspDrv::RingPush(char c)
+{
+  if(c < 32 || c > 126)
+  {
+    return false;
+  }
+  ringBuffer[ringBufferTail] = c;
+  ringBufferTail = (ringBufferTail + 1) % ringBufferLength;
+  return true;
+}
+
+// Tagy a URC končící posledním znakem v ring bufferu; true = očekávaný tag, Loop končí
+bool EspDrv::MatchRing()
+{
+  if((this->state == EspReadState::IDLE || this->state == EspReadState::BUSY) && this->expectedTag != nullptr)
+  {
+    if (CompareRingBuffer(this->expectedTag) == 0) 
     {
-      PRINTLN_DEBUG(F("CLOSED"));
+      PRINT_DEBUG(F("Tag recognized "));
+      PRINTLN_DEBUG(this->expectedTag);
+      TagReceived(this->expectedTag);
+      this->expectedTag = nullptr;
+      stats.tagsRecognized++;
       if(this->state == EspReadState::BUSY)
       {
         busyTimeout = 0;
         busyTryCount = 0;
         this->state = EspReadState::IDLE;
       }
-      GetConnectionStatus(true);
+      return true;
+    } 
+  }
+  if (CompareRingBuffer("+IPD,") == 0) 
+  {
+    PRINTLN_DEBUG(F("+IPD"));
+    stats.ipdFrames++;
+    ringBufferTail = (ringBufferTail - 5 + ringBufferLength) % ringBufferLength;
+    dataRead = 0;
+    receivedDataLength = 0;
+    startDataReadMillis = millis();
+    this->lastState = this->state;
+    this->state = EspReadState::DATA_LENGTH;
+  }
+  else if (CompareRingBuffer("STATUS:") == 0 && (this->state == EspReadState::IDLE || this->state == EspReadState::BUSY) && !statusFound) 
+  {
+    PRINTLN_DEBUG(F("STATUS"));
+    stats.statusLines++;
+    statusTimer = millis();
+    statusCounter = 0;
+    statusFound = true;
+    Arm(ESP_TIMER_STATUS, statusTimer, 1000);
+    busyTimeout = 0;
+    busyTryCount = 0;
+    this->state = EspReadState::STATUS;
+  }
+  else if (captureTag != nullptr && CompareRingBuffer(captureTag) == 0 && (this->state == EspReadState::IDLE || this->state == EspReadState::BUSY))
+  {
+    PRINTLN_DEBUG(captureTag);
+    captureTimer = millis();
+    captureLength = 0;
+    Arm(ESP_TIMER_CAPTURE, captureTimer, 1000);
+    this->state = EspReadState::CAPTURE;
+  }
+  else if (CompareRingBuffer("CLOSED") == 0 && (this->state == EspReadState::IDLE || this->state == EspReadState::BUSY)) 
+  {
+    PRINTLN_DEBUG(F("CLOSED"));
+    stats.closed++;
+    if(this->state == EspReadState::BUSY)
+    {
+      busyTimeout = 0;
+      busyTryCount = 0;
+      this->state = EspReadState::IDLE;
     }
-    else if (CompareRingBuffer("BUSY") == 0 && this->state == EspReadState::IDLE)
+    GetConnectionStatus(true);
+  }
+  else if (CompareRingBuffer("BUSY") == 0 && this->state == EspReadState::IDLE)
+  {
+    PRINTLN_WARNING(F("BUSY"));
+    stats.busy++;
+    if(busyTryCount > 10)
+    {
+      busyTimeout = 0;
+      busyTryCount = 0;
+      this->state = EspReadState::IDLE;
+      Close();
+    }
+    else
     {
-      PRINTLN_WARNING(F("BUSY"));
-      if(busyTryCount > 10)
+      busyTryCount++;
+      busyTimeout = min(busyTimeout * 2 + random(200, 1000), 5000);
+      busyTime = millis();
+      this->state = EspReadState::BUSY;
+    }
+  }
+  return false;
+}
+
+bool EspDrv::IsMqttPacketType(uint8_t header)
+{
+  // Pakety, které posílá broker klientovi
+  uint8_t type = header >> 4;
+  uint8_t flags = header & 0x0F;
+  switch(type)
+  {
+    case 3:
+      return true;
+    case 6:
+      return flags == 2;
+    case 2:
+    case 4:
+    case 5:
+    case 7:
+    case 9:
+    case 11:
+    case 13:
+      return flags == 0;
+  }
+  return false;
+}
+
+bool EspDrv::IsFrameStart(uint8_t b)
+{
+  if(datagram)
+  {
+    // MQTT-SN začíná délkou celé zprávy, 0x01 uvádí tříbytovou délku
+    return b == 0x01 || b == receivedDataLength;
+  }
+  return IsMqttPacketType(b);
+}
+
+const char* EspDrv::FindUrc()
+{
+  for(uint8_t i = 0; i < sizeof(urcSignatures) / sizeof(urcSignatures[0]); i++)
+  {
+    uint8_t length = strlen(urcSignatures[i]);
+    if(dataRead >= length && memcmp(receivedDataBuffer + dataRead - length, urcSignatures[i], length) == 0)
+    {
+      return urcSignatures[i];
+    }
+  }
+  return nullptr;
+}
+
+void EspDrv::ResyncFrame(const char* urc)
+{
+  PRINTLN_WARNING(F("+IPD resync"));
+  stats.ipdResyncs++;
+  stats.ipdDropped++;
+  dataRead = 0;
+  receivedDataLength = 0;
+  ResetBuffer(receivedDataBuffer, receivedDataBufferSize);
+  this->state = busyTryCount > 0? EspReadState::BUSY : EspReadState::IDLE;
+  if(urc != nullptr)
+  {
+    // URC se zpracuje, jako by přišel mimo rámec; koncové "\r\n" RingPush vynechá
+    for(uint8_t i = 0; urc[i] != '\0'; i++)
+    {
+      RingPush(urc[i]);
+    }
+    MatchRing();
+  }
+}
+
+void EspDrv::DeliverFrame(uint16_t length)
+{
+  if(datagram)
+  {
+    // Datagram je právě jedna zpráva MQTT-SN
+    uint16_t declared = receivedDataBuffer[0];
+    if(declared == 0x01 && length >= 3)
+    {
+      declared = ((uint16_t)receivedDataBuffer[1] << 8) | receivedDataBuffer[2];
+    }
+    if(declared != length)
+    {
+      PRINTLN_WARNING(F("MQTT-SN length mismatch"));
+      stats.ipdLengthErrors++;
+      stats.ipdDropped++;
+      return;
+    }
+    if(DataReceived != nullptr)
+    {
+      DataReceived(receivedDataBuffer, length);
+    }
+    stats.ipdDelivered++;
+    return;
+  }
+  // Rámec může obsahovat více MQTT paketů za sebou, délky musí přesně sedět
+  uint16_t offset = 0;
+  uint8_t packets = 0;
+  while(offset < length)
+  {
+    uint32_t remainingLength = 0;
+    uint8_t lengthBytes = 0;
+    bool complete = false;
+    while(!complete && lengthBytes < 4 && offset + 1 + lengthBytes < length)
+    {
+      uint8_t digit = receivedDataBuffer[offset + 1 + lengthBytes];
+      remainingLength |= (uint32_t)(digit & 0x7F) << (7 * lengthBytes);
+      lengthBytes++;
+      complete = (digit & 0x80) == 0;
+    }
+    uint32_t packetLength = 1 + lengthBytes + remainingLength;
+    bool valid = complete && IsMqttPacketType(receivedDataBuffer[offset]) && offset + packetLength <= length;
+    if(valid && (receivedDataBuffer[offset] & 0xF0) == 0x30)
+    {
+      // PUBLISH: topic (a packet id u QoS > 0) se musí vejít do paketu
+      uint8_t* variableHeader = receivedDataBuffer + offset + 1 + lengthBytes;
+      uint32_t topicLength = remainingLength >= 2 ? ((uint16_t)variableHeader[0] << 8) | variableHeader[1] : 0xFFFF;
+      uint8_t idLength = (receivedDataBuffer[offset] & 0x06) != 0 ? 2 : 0;
+      valid = 2 + topicLength + idLength <= remainingLength;
+    }
+    if(!valid)
+    {
+      PRINTLN_WARNING(F("MQTT length mismatch"));
+      stats.ipdLengthErrors++;
+      if(packets == 0)
       {
-        busyTimeout = 0;
-        busyTryCount = 0;
-        this->state = EspReadState::IDLE;
-        Close();
-        continue;
+        stats.ipdDropped++;
       }
-      else
+      // Zbytek rámce může být začátek dalšího výstupu modulu (např. "\r\n+I" z "+IPD,")
+      for(; offset < length; offset++)
       {
-        busyTryCount++;
-        busyTimeout = min(busyTimeout * 2 + random(200, 1000), 5000);
-        busyTime = millis();
-        this->state = EspReadState::BUSY;
+        RingPush(receivedDataBuffer[offset]);
       }
+      return;
     }
+    if(DataReceived != nullptr)
+    {
+      uint8_t frame = frameCount;
+      DataReceived(receivedDataBuffer + offset, packetLength);
+      if(frameCount != frame)
+      {
+        // Callback publikoval a Write mezitím přijal do bufferu další rámec, zbytek tohoto je pryč
+        stats.ipdLengthErrors++;
+        return;
+      }
+    }
+    offset += packetLength;
+    packets++;
+  }
+  stats.ipdDelivered++;
+  if(packets > 1)
+  {
+    stats.ipdCoalesced++;
+  }
+}
+
+void EspDrv::Arm(uint8_t timer, unsigned long start, unsigned long timeout)
+{
+  // CheckTimeout porovnává ostře (>), termín je až po uplynutí timeoutu
+  timers.Set(timer, start + timeout + 1);
+}
+
+bool EspDrv::TimerActive(uint8_t timer)
+{
+  switch(timer)
+  {
+    case ESP_TIMER_STATUS:
+      return this->state == EspReadState::STATUS;
+    case ESP_TIMER_DATA:
+      return this->state == EspReadState::DATA || this->state == EspReadState::DATA_LENGTH || this->state == EspReadState::SKIP;
+    case ESP_TIMER_BUSY:
+      return this->state == EspReadState::BUSY;
+    case ESP_TIMER_CAPTURE:
+      return this->state == EspReadState::CAPTURE;
+    case ESP_TIMER_SLEEP:
+      return sleepMode == ESP_SLEEP_LIGHT && !asleep;
+  }
+  return false;
+}
+
+unsigned long EspDrv::NextDeadline()
+{
+  if(RxAvailable() > 0)
+  {
+    return 0;
+  }
+  // Časovače stavů, které už skončily, se odstraní až tady
+  while(!timers.Empty() && !TimerActive(timers.FirstId()))
+  {
+    timers.Cancel(timers.FirstId());
+  }
+  return timers.Remaining(millis());
+}
+
+void EspDrv::AllocReceiveBuffer(uint8_t receivedBufferSize)
+{
+  if(!ownsReceivedDataBuffer && this->receivedDataBuffer != nullptr)
+  {
+    return;
+  }
+  delete[] this->receivedDataBuffer;
+  this->receivedDataBuffer = new uint8_t[receivedBufferSize];
+  this->receivedDataBufferSize = receivedBufferSize;
+  ownsReceivedDataBuffer = true;
+}
+
+void EspDrv::SetReceiveBuffer(uint8_t* buffer, uint16_t size)
+{
+  if(ownsReceivedDataBuffer)
+  {
+    delete[] this->receivedDataBuffer;
   }
+  this->receivedDataBuffer = buffer;
+  this->receivedDataBufferSize = size;
+  ownsReceivedDataBuffer = false;
 }
 
 void EspDrv::Init(uint8_t receivedBufferSize)
 {
-  if(this->SendCmd(F("ATE0"), "OK", 1000))
+  unsigned long start = millis();
+  AllocReceiveBuffer(receivedBufferSize);
+  if(this->SendCmd(CMD_ATE0))
+  {
+    FullReset(0);
+  }
+  initTime = millis() - start;
+}
+
+bool EspDrv::InitFast(uint8_t receivedBufferSize, unsigned long associationWait)
+{
+  unsigned long start = millis();
+  // Spojení může stále běžet, +IPD může přijít hned po startu
+  AllocReceiveBuffer(receivedBufferSize);
+  bool reused = false;
+  if(this->SendCmd(CMD_ATE0) && this->SendCmd(CMD_AT))
   {
-    if(this->SendCmd(F("AT+RST"), "OK", 30000))
+    reused = WaitForAssociation(associationWait);
+  }
+  else
+  {
+    PRINTLN_WARNING(F("Module does not respond, full reset."));
+    reused = FullReset(associationWait) && GetConnectionStatus() == WL_CONNECTED;
+  }
+  initTime = millis() - start;
+  return reused;
+}
+
+bool EspDrv::FullReset(unsigned long associationWait)
+{
+  if(this->SendCmd(CMD_RST))
+  {
+    // Po resetu modul nespí (WAKEUPGPIO ani SLEEP=1 nejsou nastavené)
+    AccountPower();
+    asleep = false;
+    delay(3000);
+    if(this->SendCmd(CMD_ATE0_BOOT))
     {
-      delay(3000);
-      if(this->SendCmd(F("ATE0"), "OK", 10000))
+      this->SendCmd(CMD_CWMODE_STATION);
+      if(sleepMode != ESP_SLEEP_NONE)
       {
-        this->SendCmd(F("AT+CWMODE=1"), "OK", 1000);
+        SetSleepMode(sleepMode);
       }
-      GetConnectionStatus(true);
     }
+    WaitForAssociation(associationWait);
+    return true;
   }
-  this->receivedDataBuffer = new uint8_t[receivedBufferSize];
-  this->receivedDataBufferSize = receivedBufferSize;
+  return false;
+}
+
+bool EspDrv::WaitForAssociation(unsigned long timeout)
+{
+  unsigned long t = millis();
+  // Modul se připojuje sám s uloženými údaji (AT+CWAUTOCONN)
+  while(GetConnectionStatus(true) != WL_CONNECTED && millis() - t < timeout)
+  {
+    wdt_reset();
+    delay(250);
+  }
+  return GetConnectionStatus() == WL_CONNECTED;
+}
+
+unsigned long EspDrv::GetInitTime()
+{
+  return this->initTime;
+}
+
+bool EspDrv::SetAutoConnect(bool enable)
+{
+  return this->SendCmd(CMD_CWAUTOCONN, enable ? 1 : 0);
 }
 
 int EspDrv::Connect(const char* ssid, const char* password) 
 {
-  if(this->SendCmd(F("AT+CWJAP_CUR=\"%s\",\"%s\""), "OK", 10000, ssid, password))
+  return Connect(ssid, password, nullptr, false);
+}
+
+int EspDrv::Connect(const char* ssid, const char* password, const char* bssid, bool store)
+{
+  // _DEF uloží údaje do flash modulu, po startu se modul připojí sám (AT+CWAUTOCONN=1)
+  bool result;
+  if(bssid != nullptr)
+  {
+    result = this->SendCmd(CMD_CWJAP_BSSID, store ? "DEF" : "CUR", ssid, password, bssid);
+  }
+  else
+  {
+    result = this->SendCmd(CMD_CWJAP, store ? "DEF" : "CUR", ssid, password);
+  }
+  if(result)
   {
     delay(100);
-    if(this->SendCmd(F("AT+CIPMUX=0"), "OK", 10000))
+    if(this->SendCmd(CMD_CIPMUX_SINGLE))
     {
       delay(100);
       int status = GetConnectionStatus(true);
@@ -341,19 +867,53 @@ int EspDrv::Connect(const char* ssid, const char* password)
 
 int EspDrv::TCPConnect(const char* url, int port)
 {
-  if(this->SendCmd(F("AT+CIPSTART=\"TCP\",\"%s\",%d"), "OK", 10000, url, port))
+  datagram = false;
+  if(this->SendCmd(CMD_CIPSTART_TCP, url, port))
   {
     delay(100);
-    GetClientStatus(true);
-    return 0;
+    return GetClientStatus(true);
   }
-  return 0;
+  // ALREADY CONNECTED končí ERROR
+  return GetClientStatus(true);
+}
+
+int EspDrv::UDPConnect(const char* url, int port, int localPort)
+{
+  // Režim 0: modul přijímá jen od zadaného vzdáleného portu
+  datagram = true;
+  if(this->SendCmd(CMD_CIPSTART_UDP, url, port, localPort))
+  {
+    delay(100);
+  }
+  return GetClientStatus(true);
+}
+
+bool EspDrv::ResolveHost(const char* host, char* ip, uint8_t ipSize)
+{
+  if(ipSize < 8)
+  {
+    return false;
+  }
+  ip[0] = '\0';
+  captureBuffer = ip;
+  captureSize = ipSize;
+  captureLength = 0;
+  captureTag = "+CIPDOMAIN:";
+  bool result = this->SendCmd(CMD_CIPDOMAIN, host);
+  if(this->state == EspReadState::CAPTURE)
+  {
+    this->state = EspReadState::IDLE;
+  }
+  captureTag = nullptr;
+  captureBuffer = nullptr;
+  return result && ip[0] != '\0';
 }
 
 bool EspDrv::Write(uint8_t* data, uint16_t length) 
 {
   bool result = false;
-  if(this->SendCmd(F("AT+CIPSEND=%d"), ">", 1000, length))
+  commandDepth++;
+  if(this->SendCmd(CMD_CIPSEND, length))
   {
     result = SendData(data, length);
     lastDataSend = millis();
@@ -362,6 +922,9 @@ bool EspDrv::Write(uint8_t* data, uint16_t length)
   {
     statusRead = millis();
   }
+  AdaptSendGap(result);
+  CommandDone();
+  commandDepth--;
   return result;
 }
 
@@ -370,35 +933,396 @@ void EspDrv::WaitUntilReady()
   do
   {
     Loop();
-  } while(this->state != EspReadState::IDLE || millis() - lastDataSend < 1000);
+    // Při vysílání po částech se nezačíná, dokud modul vysílá
+    if(txChunk > 0 && this->state == EspReadState::IDLE)
+    {
+      DrainRx();
+    }
+  } while(this->state != EspReadState::IDLE || millis() - lastDataSend < sendGap);
 }
 
 bool EspDrv::SendData(uint8_t* data, uint16_t length) 
 {
+  // Po výzvě '>' je CIPSEND otevřený: rámec přijatý mezi částmi se doručí až po zápisu všech dat
+  holdFrames = txChunk > 0;
   WaitUntilReady();
-  this->serial->write(data, length);
-  return WaitForTag("SEND OK", 1000);
+  dataStart = millis();
+  uint16_t written = 0;
+  while(written < length)
+  {
+    uint16_t chunk = length - written;
+    if(txChunk > 0)
+    {
+      chunk = min(chunk, txChunk);
+      if(written > 0)
+      {
+        DrainRx();
+      }
+    }
+    size_t accepted = this->serial->write(data + written, chunk);
+    stats.txChunks++;
+    if(accepted < chunk)
+    {
+      // Zbytek už modul nedostane, odeslání skončí timeoutem SEND OK
+      stats.txDropped += length - written - accepted;
+      break;
+    }
+    written += chunk;
+  }
+  holdFrames = false;
+  if(framePending)
+  {
+    framePending = false;
+    DeliverFrame(pendingLength);
+  }
+  unsigned long sent = millis();
+  bool result = WaitForTag("SEND OK", LearnedTimeout(ESP_LAT_SEND, ESP_SEND_TIMEOUT, ESP_SEND_TIMEOUT_MIN, ESP_SEND_TIMEOUT_MAX));
+  Learn(ESP_LAT_SEND, result, millis() - sent);
+  return result;
+}
+
+unsigned long EspDrv::LearnedTimeout(uint8_t slot, unsigned long timeout, unsigned long minTimeout, unsigned long maxTimeout)
+{
+  if(slot == ESP_LAT_NONE)
+  {
+    return timeout;
+  }
+  unsigned long learned = latency[slot].rtt.Timeout(timeout, minTimeout, maxTimeout) << latency[slot].backoff;
+  return min(learned, maxTimeout);
+}
+
+void EspDrv::Learn(uint8_t slot, bool success, unsigned long elapsed)
+{
+  if(slot == ESP_LAT_NONE)
+  {
+    return;
+  }
+  EspLatency& l = latency[slot];
+  if(!success)
+  {
+    l.backoff = min(l.backoff + 1, ESP_TIMEOUT_BACKOFF_MAX);
+    return;
+  }
+  // Po selhání může tag patřit ještě k předchozímu pokusu, takový vzorek se nepoužije
+  if(l.backoff == 0)
+  {
+    l.rtt.Sample(elapsed);
+  }
+  l.backoff = 0;
 }
 
-bool EspDrv::SendCmd(const __FlashStringHelper* cmd, const char* tag, unsigned long timeout, ...)
+void EspDrv::AdaptSendGap(bool success)
 {
-  char cmdBuf[CMD_BUFFER_SIZE];
-  va_list args;
-  va_start(args, cmd);
-  vsnprintf_P(cmdBuf, CMD_BUFFER_SIZE, (char*)cmd, args);
-  va_end(args);
+  if(!success || stats.busy != sendGapBusySeen)
+  {
+    sendGap = min(sendGap * 2UL, (unsigned long)ESP_SEND_GAP_MAX);
+  }
+  else
+  {
+    sendGap -= sendGap / 8;
+  }
+  sendGapBusySeen = stats.busy;
+  // Kolísání SEND OK ukazuje, jak dlouho se modul vzpamatovává z odeslání
+  sendGap = max(sendGap, max((uint16_t)ESP_SEND_GAP_MIN, latency[ESP_LAT_SEND].rtt.rttVar));
+}
+
+void EspDrv::DrainRx()
+{
+  uint32_t rxBytes = stats.rxBytes;
+  Loop();
+  // Modul právě vysílá: další část až po dvou dobách bytu bez příjmu
+  unsigned long start = millis();
+  unsigned long lastRx = micros();
+  while(stats.rxBytes != rxBytes && millis() - start < ESP_TX_RX_WAIT_MAX)
+  {
+    if(RxAvailable() > 0)
+    {
+      Loop();
+      lastRx = micros();
+    }
+    else if(micros() - lastRx >= 2UL * txByteMicros)
+    {
+      break;
+    }
+  }
+  if(stats.rxBytes != rxBytes)
+  {
+    stats.txRxWaits++;
+  }
+  stats.txInterleaved += stats.rxBytes - rxBytes;
+}
+
+void EspDrv::SetTxPacing(unsigned long baud, uint16_t rxBufferSize)
+{
+  if(baud == 0)
+  {
+    txChunk = 0;
+    return;
+  }
+  // Za dobu zápisu části přijde nejvýš stejně bytů, polovina bufferu zůstane na to, co už čeká
+  txChunk = max(rxBufferSize / 2, (uint16_t)ESP_TX_CHUNK_MIN);
+  txByteMicros = 10000000UL / baud;
+}
+
+uint16_t EspDrv::GetTxChunk()
+{
+  return txChunk;
+}
+
+bool EspDrv::Wake()
+{
+  if(!asleep)
+  {
+    return false;
+  }
+  // Start bit probudí modul (AT+WAKEUPGPIO na RX), prázdný řádek firmware ignoruje
+  this->serial->write('\r');
+  this->serial->write('\n');
+  delay(ESP_WAKE_DELAY);
+  AccountPower();
+  asleep = false;
+  stats.wakeups++;
+  return true;
+}
+
+bool EspDrv::ProbeAwake()
+{
+  EspCmdInfo info;
+  memcpy_P(&info, &espCmds[CMD_AT], sizeof(EspCmdInfo));
+  for(uint8_t attempt = 0; attempt < 2; attempt++)
+  {
+    if(attempt > 0)
+    {
+      PRINTLN_WARNING(F("Retry after wake-up."));
+      stats.wakeRetries++;
+    }
+    this->serial->print((const __FlashStringHelper*)info.text);
+    this->serial->write('\r');
+    this->serial->write('\n');
+    if(WaitForTag(info.tag, LearnedTimeout(info.slot, info.timeout, info.minTimeout, info.maxTimeout)))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void EspDrv::CommandDone()
+{
+  lastCommand = millis();
+  if(sleepMode == ESP_SLEEP_LIGHT && !asleep)
+  {
+    // Mezera za odesláním dat se počítá od lastDataSend (jako v Loop), dávno po odeslání už nezdržuje
+    unsigned long idle = ESP_SLEEP_REARM_IDLE;
+    unsigned long sinceSend = lastCommand - lastDataSend;
+    if(sinceSend < sendGap)
+    {
+      idle = max(idle, sendGap - sinceSend);
+    }
+    Arm(ESP_TIMER_SLEEP, lastCommand, idle);
+  }
+}
+
+void EspDrv::RearmSleep()
+{
+  stats.sleepRearms++;
+  // Při neúspěchu se další pokus odloží o ESP_SLEEP_REARM_IDLE (CommandDone)
+  if(this->SendCmd(CMD_SLEEP, ESP_SLEEP_LIGHT))
+  {
+    AccountPower();
+    asleep = true;
+  }
+}
+
+bool EspDrv::SetSleepMode(EspSleepMode mode)
+{
+  if(mode == ESP_SLEEP_LIGHT && !this->SendCmd(CMD_WAKEUPGPIO, ESP_WAKE_GPIO))
+  {
+    return false;
+  }
+  if(!this->SendCmd(CMD_SLEEP, mode))
+  {
+    return false;
+  }
+  AccountPower();
+  sleepMode = mode;
+  asleep = mode == ESP_SLEEP_LIGHT;
+  return true;
+}
+
+EspSleepMode EspDrv::SetLatencyBudget(unsigned long budget)
+{
+  // Od nejúspornějšího; starší firmware light-sleep nebo WAKEUPGPIO nezná
+  static const EspSleepMode modes[] = { ESP_SLEEP_LIGHT, ESP_SLEEP_MODEM, ESP_SLEEP_NONE };
+  for(uint8_t i = 0; i < ESP_SLEEP_MODES; i++)
+  {
+    if(GetSleepLatency(modes[i]) <= budget && SetSleepMode(modes[i]))
+    {
+      break;
+    }
+  }
+  return sleepMode;
+}
+
+EspSleepMode EspDrv::GetSleepMode()
+{
+  return sleepMode;
+}
+
+void EspDrv::SetDtimPeriod(uint8_t period)
+{
+  dtimPeriod = max(period, (uint8_t)1);
+}
+
+unsigned long EspDrv::GetSleepLatency(EspSleepMode mode)
+{
+  switch(mode)
+  {
+    case ESP_SLEEP_MODEM:
+      return (unsigned long)dtimPeriod * ESP_BEACON_INTERVAL;
+    case ESP_SLEEP_LIGHT:
+      return (unsigned long)dtimPeriod * ESP_BEACON_INTERVAL + ESP_WAKE_DELAY;
+    case ESP_SLEEP_NONE:
+    break;
+  }
+  return 0;
+}
+
+uint16_t EspDrv::GetKeepAlive(uint16_t requested)
+{
+  if(sleepMode == ESP_SLEEP_NONE || requested == 0)
+  {
+    return requested;
+  }
+  return max(requested, (uint16_t)ESP_SLEEP_KEEPALIVE);
+}
+
+unsigned long EspDrv::GetStatusCache()
+{
+  return sleepMode == ESP_SLEEP_NONE ? ESP_STATUS_CACHE : ESP_SLEEP_STATUS_CACHE;
+}
+
+unsigned long EspDrv::GetStatusDeadline()
+{
+  return statusRead + GetStatusCache();
+}
+
+EspSleepMode EspDrv::PowerState()
+{
+  return sleepMode == ESP_SLEEP_LIGHT && !asleep ? ESP_SLEEP_NONE : sleepMode;
+}
+
+void EspDrv::AccountPower()
+{
+  unsigned long now = millis();
+  powerTime[PowerState()] += now - powerSince;
+  powerSince = now;
+}
+
+unsigned long EspDrv::GetSleepTime(EspSleepMode mode)
+{
+  AccountPower();
+  return powerTime[mode];
+}
+
+float EspDrv::GetCharge()
+{
+  AccountPower();
+  // ms * uA -> mAh
+  return ((float)powerTime[ESP_SLEEP_NONE] * ESP_CURRENT_ACTIVE + (float)powerTime[ESP_SLEEP_MODEM] * ESP_CURRENT_MODEM
+    + (float)powerTime[ESP_SLEEP_LIGHT] * ESP_CURRENT_LIGHT) / 3.6e9;
+}
+
+bool EspDrv::SendCmd(EspCmd cmd, ...)
+{
+  EspCmdInfo info;
+  memcpy_P(&info, &espCmds[cmd], sizeof(EspCmdInfo));
+  commandDepth++;
   WaitUntilReady();
-  PRINTLN_DEBUG(cmdBuf);
-  this->serial->println(cmdBuf);
-  bool tagResult = WaitForTag(tag, timeout);
+  // Modul probouzející se z light-sleep může ztratit začátek prvního řádku. Opakuje se sonda AT,
+  // příkaz sám jen bez vedlejšího účinku (dvakrát poslaný CIPSTART nebo CIPSEND by rozbil spojení).
+  bool woken = Wake() && !ProbeAwake();
+  bool tagResult = false;
+  for(uint8_t attempt = 0; attempt < (woken && info.repeatable ? 2 : 1) && !tagResult; attempt++)
+  {
+    if(attempt > 0)
+    {
+      PRINTLN_WARNING(F("Retry after wake-up."));
+      stats.wakeRetries++;
+    }
+    PRINTLN_DEBUG((const __FlashStringHelper*)info.text);
+    va_list args;
+    va_start(args, cmd);
+    EmitCmd(info.text, args);
+    va_end(args);
+    unsigned long sent = millis();
+    tagResult = WaitForTag(info.tag, LearnedTimeout(info.slot, info.timeout, info.minTimeout, info.maxTimeout));
+    // Selhání kvůli probouzení nevypovídá o době odpovědi
+    if(tagResult || !woken || attempt > 0)
+    {
+      Learn(info.slot, tagResult, millis() - sent);
+    }
+  }
   if(!tagResult)
   {
-    PRINTLN_ERROR(cmdBuf);
+    PRINTLN_ERROR((const __FlashStringHelper*)info.text);
   }
   this->expectedTag = nullptr;
+  CommandDone();
+  commandDepth--;
   return tagResult;
 }
 
+void EspDrv::EmitCmd(const char* text, va_list args)
+{
+  // Argumenty se zapisují rovnou do serialu, bez mezibufferu
+  char c;
+  while((c = pgm_read_byte(text++)) != '\0')
+  {
+    if(c != '%')
+    {
+      this->serial->write(c);
+      continue;
+    }
+    c = pgm_read_byte(text++);
+    switch(c)
+    {
+      case 'd':
+        this->serial->print(va_arg(args, int));
+      break;
+      case 's':
+        this->serial->print(va_arg(args, const char*));
+      break;
+      case 'q':
+        EmitQuoted(va_arg(args, const char*));
+      break;
+      case '\0':
+        text--;
+      break;
+      default:
+        this->serial->write(c);
+      break;
+    }
+  }
+  this->serial->write('\r');
+  this->serial->write('\n');
+}
+
+void EspDrv::EmitQuoted(const char* value)
+{
+  // AT firmware vyžaduje escapování " , \ v řetězcových parametrech
+  this->serial->write('"');
+  for(; *value; value++)
+  {
+    if(*value == '"' || *value == ',' || *value == '\\')
+    {
+      this->serial->write('\\');
+    }
+    this->serial->write(*value);
+  }
+  this->serial->write('"');
+}
+
 bool EspDrv::WaitForTag(const char* pTag, unsigned long timeout) 
 {
   this->expectedTag = pTag;
@@ -419,6 +1343,7 @@ bool EspDrv::WaitForTag(const char* pTag, unsigned long timeout)
     PRINT_ERROR(" received tag ");
     PRINTLN_ERROR(tag);
     tagRecognitionFailCount = tagRecognitionFailCount == 255? tagRecognitionFailCount : tagRecognitionFailCount + 1;;
+    stats.tagFailures++;
   }
   else
   {
@@ -442,12 +1367,12 @@ void EspDrv::GetStatus(bool force)
   4 - TCP not conected
   5 - wifi not connected
   */
-  if(millis() - statusRead < 1000 && !force && lastConnectionStatus != 5)
+  if(millis() - statusRead < GetStatusCache() && !force && lastConnectionStatus != 5)
   {
     return;
   }
 
-  this->SendCmd(F("AT+CIPSTATUS"), "OK", 1000);
+  this->SendCmd(CMD_CIPSTATUS);
   statusFound = false;
   if(this->state == EspReadState::STATUS)
   {
@@ -490,27 +1415,65 @@ uint8_t EspDrv::GetClientStatus(bool force)
 
 void EspDrv::Disconnect()
 {
-  this->SendCmd(F("AT+CWQAP"), "OK", 1000);
+  this->SendCmd(CMD_CWQAP);
   lastConnectionStatus = GetConnectionStatus(true);
 }
 
 void EspDrv::Close()
 {
-  this->SendCmd(F("AT+CIPCLOSE"), "OK", 1000);
+  this->SendCmd(CMD_CIPCLOSE);
   lastConnectionStatus = GetConnectionStatus(true);
 }
 
 void EspDrv::Reset()
 {
-  if(this->SendCmd(F("AT+RST"), "OK", 30000))
+  FullReset(0);
+}
+
+bool EspDrv::GetAccessPoint(char* bssid, uint8_t bssidSize, uint8_t* channel)
+{
+  // +CWJAP_CUR:"ssid","bssid",channel,rssi, uvozovky capture vynechá
+  char line[72];
+  line[0] = '\0';
+  captureBuffer = line;
+  captureSize = sizeof(line);
+  captureLength = 0;
+  captureTag = "+CWJAP_CUR:";
+  bool result = this->SendCmd(CMD_CWJAP_QUERY);
+  if(this->state == EspReadState::CAPTURE)
   {
-    delay(3000);
-    if(this->SendCmd(F("ATE0"), "OK", 10000))
-    {
-      this->SendCmd(F("AT+CWMODE=1"), "OK", 1000);
-    }
-    lastConnectionStatus = GetConnectionStatus(true);
+    this->state = EspReadState::IDLE;
   }
+  captureTag = nullptr;
+  captureBuffer = nullptr;
+  if(!result)
+  {
+    return false;
+  }
+  // SSID může obsahovat čárky, parsuje se od konce
+  char* rssi = strrchr(line, ',');
+  if(rssi == nullptr)
+  {
+    return false;
+  }
+  *rssi = '\0';
+  char* ch = strrchr(line, ',');
+  if(ch == nullptr)
+  {
+    return false;
+  }
+  *ch = '\0';
+  char* mac = strrchr(line, ',');
+  if(mac == nullptr || strlen(mac + 1) != 17 || bssidSize < 18)
+  {
+    return false;
+  }
+  strcpy(bssid, mac + 1);
+  if(channel != nullptr)
+  {
+    *channel = (uint8_t)atoi(ch + 1);
+  }
+  return true;
 }
 
 uint8_t EspDrv::GetMemAllocFailCount()
@@ -522,3 +1485,35 @@ uint8_t EspDrv::GetTagRecognitionFailCount()
 {
   return this->tagRecognitionFailCount;
 }
+
+bool EspDrv::IsBusy()
+{
+  return this->state == EspReadState::BUSY;
+}
+
+const EspDrvStats& EspDrv::GetStats()
+{
+  return this->stats;
+}
+
+const EspLatency& EspDrv::GetLatency(uint8_t slot)
+{
+  return this->latency[slot];
+}
+
+unsigned long EspDrv::GetCmdTimeout(EspCmd cmd)
+{
+  EspCmdInfo info;
+  memcpy_P(&info, &espCmds[cmd], sizeof(EspCmdInfo));
+  return LearnedTimeout(info.slot, info.timeout, info.minTimeout, info.maxTimeout);
+}
+
+uint16_t EspDrv::GetSendGap()
+{
+  return this->sendGap;
+}
+
+unsigned long EspDrv::GetDataStart()
+{
+  return dataStart;
+}
@@ -1,8 +1,6 @@
 #ifndef __ESPDRV_H
 #define __ESPDRV_H
 
-#define CMD_BUFFER_SIZE 200
-
 #define ESP_NOTCONNECTED 0
 #define ESP_CONNECTED 1
 
@@ -13,28 +11,210 @@
 #define CL_DISCONNECTED 0
 #define CL_CONNECTED 1
 
+// Jak dlouho platí výsledek AT+CIPSTATUS bez nového dotazu (ms)
+#define ESP_STATUS_CACHE 1000
+
+// Nejdelší mezera mezi byty jednoho rámce +IPD (ms), pak se rámec zahodí
+#ifndef ESP_DATA_GAP_TIMEOUT
+#define ESP_DATA_GAP_TIMEOUT 50
+#endif
+
+// Učené timeouty: příkazy se stejným chováním sdílejí odhad doby odpovědi (slot)
+#define ESP_LAT_PROMPT 0   // AT+CIPSEND -> ">"
+#define ESP_LAT_SEND 1     // data -> SEND OK
+#define ESP_LAT_STATUS 2
+#define ESP_LAT_START 3
+#define ESP_LAT_DOMAIN 4
+#define ESP_LAT_CLOSE 5
+#define ESP_LAT_LOCAL 6    // krátké lokální příkazy (AT, CWMODE, CIPMUX, ...)
+#define ESP_LAT_SLOTS 7
+#define ESP_LAT_NONE 0xFF  // pevný timeout (reset, přihlášení k AP)
+
+// Každé selhání timeout zdvojnásobí, nejvýš 2^ESP_TIMEOUT_BACKOFF_MAX krát (a ne přes maximum příkazu)
+#ifndef ESP_TIMEOUT_BACKOFF_MAX
+#define ESP_TIMEOUT_BACKOFF_MAX 3
+#endif
+
+#ifndef ESP_SEND_TIMEOUT
+#define ESP_SEND_TIMEOUT 1000
+#endif
+#ifndef ESP_SEND_TIMEOUT_MIN
+#define ESP_SEND_TIMEOUT_MIN 200
+#endif
+#ifndef ESP_SEND_TIMEOUT_MAX
+#define ESP_SEND_TIMEOUT_MAX 5000
+#endif
+
+// Mezera mezi odesláními dat: začíná na maximu, čisté odeslání ji zmenší o 1/8,
+// BUSY nebo chyba odeslání ji zdvojnásobí
+#ifndef ESP_SEND_GAP_MIN
+#define ESP_SEND_GAP_MIN 10
+#endif
+#ifndef ESP_SEND_GAP_MAX
+#define ESP_SEND_GAP_MAX 1000
+#endif
+
+// Vysílání dat po částech (SetTxPacing): SoftwareSerial při vysílání zakáže přerušení,
+// takže co modul pošle během dlouhého zápisu, se ztratí. Mezi částmi se vyčte RX.
+#ifndef ESP_TX_CHUNK_MIN
+#define ESP_TX_CHUNK_MIN 8
+#endif
+// Nejdéle (ms), co se před další částí čeká, až modul dovysílá
+#ifndef ESP_TX_RX_WAIT_MAX
+#define ESP_TX_RX_WAIT_MAX 20
+#endif
+
+// Časovače pro NextDeadline
+#define ESP_TIMER_STATUS 0
+#define ESP_TIMER_DATA 1
+#define ESP_TIMER_BUSY 2
+#define ESP_TIMER_CAPTURE 3
+#define ESP_TIMER_SLEEP 4
+
+// Úsporné režimy (SetLatencyBudget): interval beaconů AP (ms, 100 TU) a výchozí perioda DTIM.
+// V modem-sleep i light-sleep modul poslouchá jen beacony DTIM, příchozí data čekají na AP.
+#ifndef ESP_BEACON_INTERVAL
+#define ESP_BEACON_INTERVAL 102
+#endif
+#ifndef ESP_DTIM_PERIOD
+#define ESP_DTIM_PERIOD 1
+#endif
+// GPIO pro probuzení z light-sleep: 3 = RX, modul probudí start bit prvního bytu (ten se ztratí)
+#ifndef ESP_WAKE_GPIO
+#define ESP_WAKE_GPIO 3
+#endif
+// Čekání po probouzecím bytu, než modul přijme příkaz (ms); zároveň zpoždění příjmu navíc proti modem-sleep
+#ifndef ESP_WAKE_DELAY
+#define ESP_WAKE_DELAY 5
+#endif
+// Po probuzení z UARTu modul sám znovu neusne, AT+SLEEP=1 se pošle po tolika ms bez příkazu.
+// Krátká doba: další příkaz stojí probuzení (ESP_WAKE_DELAY), bdění ale odebírá víc než modem-sleep.
+#ifndef ESP_SLEEP_REARM_IDLE
+#define ESP_SLEEP_REARM_IDLE 100
+#endif
+// Nejkratší MQTT keep-alive v úsporném režimu (s); PINGREQ budí rádio. Musí zůstat pod
+// timeoutem NAT na routeru, jinak přestanou chodit příchozí zprávy.
+#ifndef ESP_SLEEP_KEEPALIVE
+#define ESP_SLEEP_KEEPALIVE 120
+#endif
+// Platnost AT+CIPSTATUS v úsporném režimu (ms); dotaz budí modul. Pád spojení ohlásí URC CLOSED
+// a mrtvé spojení odhalí PINGREQ, kontrola stavu proto stačí zhruba jednou za keep-alive.
+#ifndef ESP_SLEEP_STATUS_CACHE
+#define ESP_SLEEP_STATUS_CACHE (ESP_SLEEP_KEEPALIVE * 1000UL)
+#endif
+// Průměrný odběr modulu (uA) pro GetCharge, podle datasheetu ESP8266EX
+#ifndef ESP_CURRENT_ACTIVE
+#define ESP_CURRENT_ACTIVE 70000
+#endif
+#ifndef ESP_CURRENT_MODEM
+#define ESP_CURRENT_MODEM 15000
+#endif
+#ifndef ESP_CURRENT_LIGHT
+#define ESP_CURRENT_LIGHT 900
+#endif
+
 #include <Arduino.h>
+#include "EspRxRing.h"
+#include "DeadlineList.h"
+#include "RttEstimator.h"
 
 
 enum EspReadState {
   IDLE = 0,          // čeká na data/odpovědi
   DATA_LENGTH,       // čtení délky dat za +IPD
   DATA,              // čtení samotných dat +IPD
+  SKIP,              // přeskočení dat +IPD, která se nevešla do bufferu nebo přišla za odloženým rámcem
   STATUS,
-  BUSY
+  BUSY,
+  CAPTURE            // čtení hodnoty za captureTag (např. +CIPDOMAIN:)
+};
+
+// Hodnota je parametr AT+SLEEP
+enum EspSleepMode
+{
+  ESP_SLEEP_NONE = 0,
+  ESP_SLEEP_LIGHT = 1,   // spí i CPU, probouzí ho DTIM nebo byte na RX (AT+WAKEUPGPIO)
+  ESP_SLEEP_MODEM = 2    // rádio spí mezi beacony DTIM, UART běží
+};
+#define ESP_SLEEP_MODES 3
+
+// Počítadla událostí parseru (pro diagnostiku a replay)
+struct EspDrvStats
+{
+  uint32_t rxBytes = 0;
+  uint16_t ipdFrames = 0;
+  uint16_t ipdDelivered = 0;
+  uint16_t ipdDropped = 0;
+  uint16_t tagsRecognized = 0;
+  uint16_t tagFailures = 0;
+  uint16_t statusLines = 0;
+  uint16_t closed = 0;
+  uint16_t busy = 0;
+  uint16_t dataTimeouts = 0;
+  uint16_t statusTimeouts = 0;
+  uint16_t busyTimeouts = 0;
+  uint16_t ipdResyncs = 0;
+  uint16_t ipdLengthErrors = 0;
+  uint16_t ipdCoalesced = 0;
+  // Rámce přijaté mezi částmi dat, doručené až po zápisu všech částí
+  uint16_t ipdDeferred = 0;
+  // Vysílání po částech: počet částí, byty, které serial nepřijal, přijaté byty mezi částmi
+  // a kolikrát se čekalo na konec vysílání modulu
+  uint16_t txChunks = 0;
+  uint16_t txDropped = 0;
+  uint16_t txInterleaved = 0;
+  uint16_t txRxWaits = 0;
+  // Light-sleep: probuzení před příkazem, opakování sondy AT nebo příkazu po probuzení, nová AT+SLEEP=1
+  uint16_t wakeups = 0;
+  uint16_t wakeRetries = 0;
+  uint16_t sleepRearms = 0;
+};
+
+struct EspLatency
+{
+  RttEstimator rtt;
+  uint8_t backoff = 0;
+};
+
+enum EspCmd
+{
+  CMD_AT = 0,
+  CMD_ATE0,
+  CMD_ATE0_BOOT,
+  CMD_RST,
+  CMD_CWMODE_STATION,
+  CMD_CWAUTOCONN,
+  CMD_CWJAP,
+  CMD_CWJAP_BSSID,
+  CMD_CWJAP_QUERY,
+  CMD_CWQAP,
+  CMD_CIPMUX_SINGLE,
+  CMD_CIPSTART_TCP,
+  CMD_CIPSTART_UDP,
+  CMD_CIPDOMAIN,
+  CMD_CIPSEND,
+  CMD_CIPSTATUS,
+  CMD_CIPCLOSE,
+  CMD_SLEEP,
+  CMD_WAKEUPGPIO,
+  CMD_COUNT
 };
 
 class EspDrv
 {
   private:
     Stream *serial;
+    EspRxRing* rxRing = nullptr;
     unsigned char ringBuffer[16];
     uint8_t ringBufferLength = 16;
     uint8_t ringBufferTail = 0;
     EspReadState state = EspReadState::IDLE;
     EspReadState lastState = EspReadState::IDLE;
-    uint8_t* receivedDataBuffer;
+    uint8_t* receivedDataBuffer = nullptr;
     uint16_t receivedDataBufferSize = 0;
+    bool ownsReceivedDataBuffer = true;
+    // UDP: rámec +IPD je jeden datagram MQTT-SN, ne proud MQTT paketů
+    bool datagram = false;
     uint16_t receivedDataLength;
     uint16_t dataRead = 0;
     const char* tag = "";
@@ -42,6 +222,7 @@ class EspDrv
     unsigned long statusRead = 0;
     int lastConnectionStatus = 5;
     unsigned long lastDataSend = 0;
+    unsigned long dataStart = 0;
     unsigned long statusTimer = 0;
     uint8_t statusCounter = 0;
     const char* expectedTag = nullptr;
@@ -51,9 +232,40 @@ class EspDrv
     uint8_t busyTryCount = 0;
     uint8_t memAllocFailCount = 0;
     uint8_t tagRecognitionFailCount = 0;
+    const char* captureTag = nullptr;
+    char* captureBuffer = nullptr;
+    uint8_t captureSize = 0;
+    uint8_t captureLength = 0;
+    unsigned long captureTimer = 0;
+    unsigned long initTime = 0;
+    EspDrvStats stats;
+    DeadlineList<5> timers;
+    EspLatency latency[ESP_LAT_SLOTS];
+    uint16_t sendGap = ESP_SEND_GAP_MAX;
+    uint16_t sendGapBusySeen = 0;
+    // 0 = data se zapíšou najednou
+    uint16_t txChunk = 0;
+    unsigned int txByteMicros = 0;
+    // Během zápisu dat po částech se přijatý rámec jen nechá v bufferu, doručí ho SendData po zápisu
+    bool holdFrames = false;
+    bool framePending = false;
+    uint16_t pendingLength = 0;
+    // Počet započatých rámců; DeliverFrame pozná, že callback mezitím přepsal buffer
+    uint8_t frameCount = 0;
+    EspSleepMode sleepMode = ESP_SLEEP_NONE;
+    // Light-sleep je zapnutý a modul od té doby nikdo nebudil
+    bool asleep = false;
+    uint8_t dtimPeriod = ESP_DTIM_PERIOD;
+    // Vnoření SendCmd/Write, Loop posílá AT+SLEEP jen mimo ně
+    uint8_t commandDepth = 0;
+    unsigned long lastCommand = 0;
+    unsigned long powerSince = 0;
+    unsigned long powerTime[ESP_SLEEP_MODES] = {};
 
     bool SendData(uint8_t* data, uint16_t length);
-    bool SendCmd(const __FlashStringHelper* cmd, const char* tag, unsigned long timeout, ...);
+    bool SendCmd(EspCmd cmd, ...);
+    void EmitCmd(const char* text, va_list args);
+    void EmitQuoted(const char* value);
     void TagReceived(const char* pTag);
     bool WaitForTag(const char* pTag, unsigned long timeout);
     void GetStatus(bool force);
@@ -63,22 +275,88 @@ class EspDrv
     void ResetBuffer(uint8_t* buffer, uint16_t length);
     void CheckTimeout();
     void WaitUntilReady();
+    unsigned long LearnedTimeout(uint8_t slot, unsigned long timeout, unsigned long minTimeout, unsigned long maxTimeout);
+    void Learn(uint8_t slot, bool success, unsigned long elapsed);
+    void AdaptSendGap(bool success);
+    void DrainRx();
+    uint8_t RxAvailable();
+    int RxRead();
+    bool FullReset(unsigned long associationWait);
+    bool WaitForAssociation(unsigned long timeout);
+    void AllocReceiveBuffer(uint8_t receivedBufferSize);
+    void Arm(uint8_t timer, unsigned long start, unsigned long timeout);
+    bool RingPush(char c);
+    bool MatchRing();
+    static bool IsMqttPacketType(uint8_t header);
+    bool IsFrameStart(uint8_t b);
+    const char* FindUrc();
+    void ResyncFrame(const char* urc);
+    void DeliverFrame(uint16_t length);
+    bool TimerActive(uint8_t timer);
+    bool Wake();
+    // Po probuzení pošle AT (nejvýš dvakrát); false, pokud modul neodpověděl
+    bool ProbeAwake();
+    void CommandDone();
+    void RearmSleep();
+    EspSleepMode PowerState();
+    void AccountPower();
 
   public:
     EspDrv(Stream *serial);
+    // Statický buffer pro +IPD místo alokace v Init; volat před Init
+    void SetReceiveBuffer(uint8_t* buffer, uint16_t size);
     void Init(uint8_t receivedBufferSize);
+    bool InitFast(uint8_t receivedBufferSize, unsigned long associationWait = 0);
+    unsigned long GetInitTime();
     int Connect(const char* ssid, const char* password);
+    int Connect(const char* ssid, const char* password, const char* bssid, bool store);
+    bool SetAutoConnect(bool enable);
+    bool GetAccessPoint(char* bssid, uint8_t bssidSize, uint8_t* channel);
     int TCPConnect(const char* url, int port);
+    int UDPConnect(const char* url, int port, int localPort);
+    bool ResolveHost(const char* host, char* ip, uint8_t ipSize);
     void Disconnect();
     bool Write(uint8_t* data, uint16_t length);
     void Loop();
-    void (*DataReceived) (uint8_t* buffer, int length);
+    void SetRxRing(EspRxRing* ring);
+    void PumpRx();
+    void (*DataReceived) (uint8_t* buffer, int length) = nullptr;
     int GetConnectionStatus();
     uint8_t GetClientStatus();
     void Close();
     void Reset();
     uint8_t GetMemAllocFailCount();
     uint8_t GetTagRecognitionFailCount();
-    void (*DataTimeout)();
+    bool IsBusy();
+    // Doba (ms), po kterou Loop nemá co dělat; 0 = volat hned, DEADLINE_NONE = jen na data z UARTu
+    unsigned long NextDeadline();
+    const EspDrvStats& GetStats();
+    const EspLatency& GetLatency(uint8_t slot);
+    unsigned long GetCmdTimeout(EspCmd cmd);
+    uint16_t GetSendGap();
+    // Kdy začal zápis dat posledního CIPSEND (millis), po čekání na modul a výzvě '>'
+    unsigned long GetDataStart();
+    // Vysílání po částech velikosti poloviny RX bufferu (SoftwareSerial 64 B); baud = 0 vypne
+    void SetTxPacing(unsigned long baud, uint16_t rxBufferSize);
+    uint16_t GetTxChunk();
+    // Pošle AT+SLEEP (light-sleep s probouzením přes RX); po resetu modulu se nastaví znovu
+    bool SetSleepMode(EspSleepMode mode);
+    // Nejdelší přijatelné zpoždění příchozích dat (ms), zapne nejúspornější režim, který ho splní
+    EspSleepMode SetLatencyBudget(unsigned long budget);
+    EspSleepMode GetSleepMode();
+    void SetDtimPeriod(uint8_t period);
+    // Nejhorší zpoždění příchozích dat v režimu (ms)
+    unsigned long GetSleepLatency(EspSleepMode mode);
+    // MQTT keep-alive (s) pro nastavený režim, 0 zůstane vypnutý
+    uint16_t GetKeepAlive(uint16_t requested);
+    // Jak dlouho platí výsledek AT+CIPSTATUS pro nastavený režim (ms)
+    unsigned long GetStatusCache();
+    // Kdy vyprší platnost posledního stavu (millis), další GetConnectionStatus se pak ptá modulu
+    unsigned long GetStatusDeadline();
+    // Čas v režimu (ms), ESP_SLEEP_NONE zahrnuje i bdění po probuzení z light-sleep
+    unsigned long GetSleepTime(EspSleepMode mode);
+    // Odhad náboje spotřebovaného modulem (mAh) podle ESP_CURRENT_*
+    float GetCharge();
+    void (*DataTimeout)() = nullptr;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,111 @@
+#ifndef __ESPRXRING_H
+#define __ESPRXRING_H
+
+#include <Arduino.h>
+
+/*
+  Single-producer/single-consumer byte ring between the UART RX interrupt (producer)
+  and EspDrv::Loop (consumer). Size must be a power of two, at most 256; one slot stays empty.
+  Check a static buffer with static_assert(EspRxRing::ValidSize(sizeof(buffer)), ...).
+  Indices are single bytes, so they are read and written atomically on AVR.
+*/
+#if defined(__AVR__)
+  #define ESP_RING_LOAD(x) (x)
+  #define ESP_RING_STORE(x, v) do { asm volatile("" ::: "memory"); (x) = (v); } while(0)
+#else
+  #define ESP_RING_LOAD(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+  #define ESP_RING_STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#endif
+
+class EspRxRing
+{
+  private:
+    uint8_t* buffer;
+    uint8_t mask;
+    volatile uint8_t head = 0;
+    volatile uint8_t tail = 0;
+    volatile uint16_t overruns = 0;
+    uint8_t highWater = 0;
+
+  public:
+    EspRxRing(uint8_t* buffer, uint16_t size)
+    {
+      this->buffer = buffer;
+      // Indexy se maskují, jiná velikost se zmenší na nejbližší mocninu dvou
+      uint16_t capacity = 256;
+      while(capacity > size)
+      {
+        capacity >>= 1;
+      }
+      this->mask = (uint8_t)(capacity - 1);
+    }
+
+    static constexpr bool ValidSize(uint16_t size)
+    {
+      return size >= 2 && size <= 256 && (size & (size - 1)) == 0;
+    }
+
+    // Producent (přerušení)
+    bool Push(uint8_t b)
+    {
+      uint8_t h = head;
+      uint8_t next = (h + 1) & mask;
+      if(next == ESP_RING_LOAD(tail))
+      {
+        overruns++;
+        return false;
+      }
+      buffer[h] = b;
+      ESP_RING_STORE(head, next);
+      return true;
+    }
+
+    // Konzument
+    uint8_t Available()
+    {
+      uint8_t count = (ESP_RING_LOAD(head) - tail) & mask;
+      if(count > highWater)
+      {
+        highWater = count;
+      }
+      return count;
+    }
+
+    int Pop()
+    {
+      uint8_t t = tail;
+      if(t == ESP_RING_LOAD(head))
+      {
+        return -1;
+      }
+      uint8_t b = buffer[t];
+      ESP_RING_STORE(tail, (uint8_t)((t + 1) & mask));
+      return b;
+    }
+
+    uint8_t Capacity()
+    {
+      return mask;
+    }
+
+    uint8_t GetHighWater()
+    {
+      return highWater;
+    }
+
+    uint16_t GetOverruns()
+    {
+      uint16_t result;
+#if defined(__AVR__)
+      uint8_t sreg = SREG;
+      cli();
+      result = overruns;
+      SREG = sreg;
+#else
+      result = __atomic_load_n(&overruns, __ATOMIC_RELAXED);
+#endif
+      return result;
+    }
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include "EspTrace.h"
+
+EspTraceStream::EspTraceStream(Stream* serial, Print* sink)
+{
+  this->serial = serial;
+  this->sink = sink;
+}
+
+int EspTraceStream::available()
+{
+  return this->serial->available();
+}
+
+int EspTraceStream::read()
+{
+  int raw = this->serial->read();
+  if(raw != -1)
+  {
+    Record('R', (uint8_t)raw);
+  }
+  return raw;
+}
+
+int EspTraceStream::peek()
+{
+  return this->serial->peek();
+}
+
+size_t EspTraceStream::write(uint8_t b)
+{
+  Record('T', b);
+  return this->serial->write(b);
+}
+
+size_t EspTraceStream::write(const uint8_t* buffer, size_t size)
+{
+  for(size_t i = 0; i < size; i++)
+  {
+    Record('T', buffer[i]);
+  }
+  return this->serial->write(buffer, size);
+}
+
+void EspTraceStream::Record(char direction, uint8_t b)
+{
+  unsigned long t = millis();
+  if(recordLength == ESP_TRACE_RECORD_SIZE || (recordLength > 0 && (direction != recordDirection || t != recordTime)))
+  {
+    Flush();
+  }
+  if(recordLength == 0)
+  {
+    recordDirection = direction;
+    recordTime = t;
+  }
+  record[recordLength++] = b;
+}
+
+void EspTraceStream::Flush()
+{
+  if(recordLength == 0)
+  {
+    return;
+  }
+  sink->print(recordDirection);
+  sink->print(' ');
+  sink->print(recordTime);
+  sink->print(' ');
+  for(uint8_t i = 0; i < recordLength; i++)
+  {
+    if(record[i] < 0x10)
+    {
+      sink->print('0');
+    }
+    sink->print(record[i], HEX);
+  }
+  sink->println();
+  recordLength = 0;
+}
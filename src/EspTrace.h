@@ -0,0 +1,39 @@
+#ifndef __ESPTRACE_H
+#define __ESPTRACE_H
+
+#include <Arduino.h>
+
+#define ESP_TRACE_RECORD_SIZE 16
+
+/*
+  Stream wrapper recording the UART traffic between EspDrv and the module.
+
+  Format (one record per line, text so it can be captured over Serial):
+    R <millis> <hex bytes>   bytes received from the module
+    T <millis> <hex bytes>   bytes sent to the module
+  Consecutive bytes with the same direction and timestamp share a record.
+  The captures are replayed on the host by extras/replay.
+*/
+class EspTraceStream : public Stream
+{
+  private:
+    Stream* serial;
+    Print* sink;
+    uint8_t record[ESP_TRACE_RECORD_SIZE];
+    uint8_t recordLength = 0;
+    char recordDirection = 'R';
+    unsigned long recordTime = 0;
+
+    void Record(char direction, uint8_t b);
+
+  public:
+    EspTraceStream(Stream* serial, Print* sink);
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t b);
+    size_t write(const uint8_t* buffer, size_t size);
+    void Flush();
+};
+
+#endif
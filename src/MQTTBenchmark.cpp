@@ -0,0 +1,286 @@
+#include "MQTTBenchmark.h"
+
+void LatencyHistogram::Reset()
+{
+  memset(buckets, 0, sizeof(buckets));
+  count = 0;
+  maxValue = 0;
+}
+
+uint8_t LatencyHistogram::Bucket(unsigned long value)
+{
+  if(value < (1UL << BENCH_HISTOGRAM_SUB_BITS))
+  {
+    return value;
+  }
+  if(value >= (1UL << BENCH_HISTOGRAM_RANGE_BITS))
+  {
+    return BENCH_HISTOGRAM_BUCKETS - 1;
+  }
+  uint8_t msb = BENCH_HISTOGRAM_SUB_BITS;
+  while((value >> (msb + 1)) != 0)
+  {
+    msb++;
+  }
+  uint8_t octave = msb - BENCH_HISTOGRAM_SUB_BITS + 1;
+  uint8_t sub = (value >> (msb - BENCH_HISTOGRAM_SUB_BITS)) & ((1 << BENCH_HISTOGRAM_SUB_BITS) - 1);
+  return (octave << BENCH_HISTOGRAM_SUB_BITS) | sub;
+}
+
+unsigned long LatencyHistogram::BucketLimit(uint8_t bucket)
+{
+  if(bucket < (1 << BENCH_HISTOGRAM_SUB_BITS))
+  {
+    return bucket;
+  }
+  uint8_t octave = bucket >> BENCH_HISTOGRAM_SUB_BITS;
+  uint8_t sub = bucket & ((1 << BENCH_HISTOGRAM_SUB_BITS) - 1);
+  uint8_t shift = octave - 1;
+  unsigned long lower = ((1UL << BENCH_HISTOGRAM_SUB_BITS) + sub) << shift;
+  return lower + (1UL << shift) - 1;
+}
+
+void LatencyHistogram::Add(unsigned long value)
+{
+  uint8_t bucket = Bucket(value);
+  if(buckets[bucket] < 0xFFFF)
+  {
+    buckets[bucket]++;
+  }
+  count = count == 0xFFFF ? count : count + 1;
+  maxValue = max(maxValue, value);
+}
+
+unsigned long LatencyHistogram::Percentile(uint8_t percent) const
+{
+  if(count == 0)
+  {
+    return 0;
+  }
+  uint32_t target = ((uint32_t)count * percent + 99) / 100;
+  uint32_t cumulative = 0;
+  for(uint8_t i = 0; i < BENCH_HISTOGRAM_BUCKETS; i++)
+  {
+    cumulative += buckets[i];
+    if(cumulative >= target)
+    {
+      return min(BucketLimit(i), maxValue);
+    }
+  }
+  return maxValue;
+}
+
+MQTTBenchmark::MQTTBenchmark(MQTTClient* client, const char* topic)
+{
+  this->client = client;
+  this->topic = topic;
+  histogram.Reset();
+}
+
+void MQTTBenchmark::Start(uint16_t count, uint16_t messagesPerSecond, uint8_t payloadSize)
+{
+  this->count = count;
+  this->interval = 1000UL / max(messagesPerSecond, 1);
+  this->payloadSize = constrain(payloadSize, BENCH_PROBE_HEADER, BENCH_MAX_PAYLOAD);
+  for(uint8_t i = BENCH_PROBE_HEADER; i < this->payloadSize; i++)
+  {
+    payload[i] = 'A' + (i % 26);
+  }
+  sent = publishFailures = received = reordered = duplicates = corrupted = 0;
+  highestSeq = 0;
+  seenWindow = 0;
+  firstReceiveTime = lastReceiveTime = 0;
+  histogram.Reset();
+  startTime = nextSend = lastSendTime = millis();
+  running = true;
+}
+
+bool MQTTBenchmark::Loop()
+{
+  if(!running)
+  {
+    return false;
+  }
+  unsigned long now = millis();
+  if(sent + publishFailures < count)
+  {
+    if((long)(now - nextSend) >= 0)
+    {
+      uint32_t seq = sent + publishFailures + 1;
+      uint32_t timestamp = now;
+      memcpy(payload, &seq, 4);
+      memcpy(payload + 4, &timestamp, 4);
+      // Neúspěšné odeslání se do latence ani ztrát nepočítá
+      if(client->Publish(topic, payload, payloadSize))
+      {
+        sent++;
+        lastSendTime = now;
+      }
+      else
+      {
+        publishFailures++;
+      }
+      nextSend += interval;
+      // Zpožděné odesílání se nedohání dávkou
+      if((long)(millis() - nextSend) > (long)interval)
+      {
+        nextSend = millis();
+      }
+    }
+    return true;
+  }
+  if(received >= sent || now - lastSendTime > BENCH_DRAIN_TIME)
+  {
+    running = false;
+  }
+  return running;
+}
+
+bool MQTTBenchmark::MessageReceived(const char* topic, const uint8_t* payload, uint16_t length)
+{
+  if(length < BENCH_PROBE_HEADER || strcmp(topic, this->topic) != 0)
+  {
+    return false;
+  }
+  // Poškozená sonda (chybějící nebo cizí byty v rámci) se nepočítá jako přijatá
+  bool intact = length == payloadSize;
+  for(uint8_t i = BENCH_PROBE_HEADER; intact && i < length; i++)
+  {
+    intact = payload[i] == 'A' + (i % 26);
+  }
+  if(!intact)
+  {
+    corrupted++;
+    return true;
+  }
+  unsigned long now = millis();
+  uint32_t seq;
+  uint32_t timestamp;
+  memcpy(&seq, payload, 4);
+  memcpy(&timestamp, payload + 4, 4);
+  if(seq > highestSeq)
+  {
+    uint32_t shift = seq - highestSeq;
+    seenWindow = shift >= 32 ? 1 : (seenWindow << shift) | 1;
+    highestSeq = seq;
+  }
+  else
+  {
+    uint32_t distance = highestSeq - seq;
+    if(distance < 32)
+    {
+      if(seenWindow & (1UL << distance))
+      {
+        duplicates++;
+        return true;
+      }
+      seenWindow |= 1UL << distance;
+    }
+    reordered++;
+  }
+  received++;
+  if(firstReceiveTime == 0)
+  {
+    firstReceiveTime = now;
+  }
+  lastReceiveTime = now;
+  histogram.Add((uint32_t)now - timestamp);
+  return true;
+}
+
+bool MQTTBenchmark::IsRunning()
+{
+  return running;
+}
+
+unsigned long MQTTBenchmark::NextDeadline()
+{
+  if(!running)
+  {
+    return DEADLINE_NONE;
+  }
+  unsigned long deadline = sent + publishFailures < count ? nextSend : lastSendTime + BENCH_DRAIN_TIME + 1;
+  long diff = (long)(deadline - millis());
+  return diff > 0 ? (unsigned long)diff : 0;
+}
+
+void MQTTBenchmark::PrintSummary(Print* out)
+{
+  out->print(F("Benchmark sent "));
+  out->print(sent);
+  out->print(F(" failed "));
+  out->print(publishFailures);
+  out->print(F(" received "));
+  out->print(received);
+  out->print(F(" lost "));
+  out->print(GetLost());
+  out->print(F(" reordered "));
+  out->print(reordered);
+  out->print(F(" duplicates "));
+  out->print(duplicates);
+  out->print(F(" corrupted "));
+  out->println(corrupted);
+  out->print(F("RTT ms p50 "));
+  out->print(histogram.Percentile(50));
+  out->print(F(" p95 "));
+  out->print(histogram.Percentile(95));
+  out->print(F(" p99 "));
+  out->print(histogram.Percentile(99));
+  out->print(F(" max "));
+  out->println(histogram.maxValue);
+  uint32_t rate = GetRate100();
+  out->print(F("Rate "));
+  out->print(rate / 100);
+  out->print('.');
+  if(rate % 100 < 10)
+  {
+    out->print('0');
+  }
+  out->print(rate % 100);
+  out->println(F(" msg/s"));
+}
+
+const LatencyHistogram& MQTTBenchmark::GetHistogram()
+{
+  return histogram;
+}
+
+uint32_t MQTTBenchmark::GetSent()
+{
+  return sent;
+}
+
+uint32_t MQTTBenchmark::GetReceived()
+{
+  return received;
+}
+
+uint32_t MQTTBenchmark::GetLost()
+{
+  return sent > received ? sent - received : 0;
+}
+
+uint32_t MQTTBenchmark::GetReordered()
+{
+  return reordered;
+}
+
+uint32_t MQTTBenchmark::GetCorrupted()
+{
+  return corrupted;
+}
+
+uint32_t MQTTBenchmark::GetPublishFailures()
+{
+  return publishFailures;
+}
+
+uint32_t MQTTBenchmark::GetRate100()
+{
+  unsigned long elapsed = lastReceiveTime - startTime;
+  if(received == 0 || elapsed == 0)
+  {
+    return 0;
+  }
+  return (uint32_t)((uint64_t)received * 100000UL / elapsed);
+}
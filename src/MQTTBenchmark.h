@@ -0,0 +1,96 @@
+#ifndef __MQTTBENCHMARK_H
+#define __MQTTBENCHMARK_H
+
+#include "MQTTClient.h"
+
+// Počet podintervalů v každé oktávě histogramu je 2^BENCH_HISTOGRAM_SUB_BITS
+#ifndef BENCH_HISTOGRAM_SUB_BITS
+#define BENCH_HISTOGRAM_SUB_BITS 2
+#endif
+// Histogram pokrývá 0 až 2^BENCH_HISTOGRAM_RANGE_BITS - 1 ms, delší časy padnou do posledního koše
+#ifndef BENCH_HISTOGRAM_RANGE_BITS
+#define BENCH_HISTOGRAM_RANGE_BITS 16
+#endif
+#define BENCH_HISTOGRAM_BUCKETS ((BENCH_HISTOGRAM_RANGE_BITS - BENCH_HISTOGRAM_SUB_BITS + 1) << BENCH_HISTOGRAM_SUB_BITS)
+
+#ifndef BENCH_MAX_PAYLOAD
+#define BENCH_MAX_PAYLOAD 64
+#endif
+// Po odeslání poslední sondy se tak dlouho čeká na opožděné odpovědi
+#ifndef BENCH_DRAIN_TIME
+#define BENCH_DRAIN_TIME 5000
+#endif
+
+// Sonda: pořadové číslo (4 B), čas odeslání v ms (4 B), výplň
+#define BENCH_PROBE_HEADER 8
+
+/*
+  Histogram s logaritmickými koši: hodnoty pod 2^SUB_BITS mají vlastní koš,
+  každá další oktáva je rozdělená na 2^SUB_BITS stejných košů (relativní chyba do 1/2^SUB_BITS).
+*/
+struct LatencyHistogram
+{
+  uint16_t buckets[BENCH_HISTOGRAM_BUCKETS];
+  uint16_t count;
+  unsigned long maxValue;
+
+  void Reset();
+  void Add(unsigned long value);
+  // Horní mez koše, do kterého padne daný percentil (0-100)
+  unsigned long Percentile(uint8_t percent) const;
+  static uint8_t Bucket(unsigned long value);
+  static unsigned long BucketLimit(uint8_t bucket);
+};
+
+/*
+  Měření latence a propustnosti přes echo topic. Sondy s pořadovým číslem a časem se publikují
+  zadanou rychlostí; klient musí mít topic odebíraný a předávat zprávy do MessageReceived.
+*/
+class MQTTBenchmark
+{
+  private:
+    MQTTClient* client;
+    const char* topic;
+    uint8_t payload[BENCH_MAX_PAYLOAD];
+    uint8_t payloadSize = BENCH_PROBE_HEADER;
+    uint16_t count = 0;
+    unsigned long interval = 0;
+    unsigned long nextSend = 0;
+    unsigned long startTime = 0;
+    unsigned long lastSendTime = 0;
+    unsigned long firstReceiveTime = 0;
+    unsigned long lastReceiveTime = 0;
+    bool running = false;
+    uint32_t sent = 0;
+    uint32_t publishFailures = 0;
+    uint32_t received = 0;
+    uint32_t reordered = 0;
+    uint32_t duplicates = 0;
+    uint32_t corrupted = 0;
+    uint32_t highestSeq = 0;
+    // Bit i: přišla sonda highestSeq - i
+    uint32_t seenWindow = 0;
+    LatencyHistogram histogram;
+
+  public:
+    MQTTBenchmark(MQTTClient* client, const char* topic);
+    void Start(uint16_t count, uint16_t messagesPerSecond, uint8_t payloadSize = BENCH_PROBE_HEADER);
+    bool Loop();
+    bool MessageReceived(const char* topic, const uint8_t* payload, uint16_t length);
+    bool IsRunning();
+    // Doba (ms) do další sondy nebo konce čekání na odpovědi
+    unsigned long NextDeadline();
+    void PrintSummary(Print* out);
+    const LatencyHistogram& GetHistogram();
+    uint32_t GetSent();
+    uint32_t GetReceived();
+    uint32_t GetLost();
+    uint32_t GetReordered();
+    // Sondy s jinou délkou nebo výplní, než byla odeslána
+    uint32_t GetCorrupted();
+    uint32_t GetPublishFailures();
+    // Zprávy za sekundu od první do poslední přijaté sondy, v setinách
+    uint32_t GetRate100();
+};
+
+#endif
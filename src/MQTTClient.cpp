@@ -2,18 +2,92 @@
 #include <avr/wdt.h>
 
 static bool MQTTClient::pingOutstanding = false;
+static unsigned long MQTTClient::pingSent = 0;
+static unsigned long MQTTClient::lastInActivity = 0;
+static unsigned long MQTTClient::rttProbeStart = 0;
+static uint8_t MQTTClient::rttProbePacket = 0;
+static bool MQTTClient::rttProbeWriting = false;
+static unsigned long MQTTClient::rttProbeAnswer = 0;
+static RttEstimator MQTTClient::rtt;
 static void (*MQTTClient::callback)(char* topic, uint8_t* payload, uint16_t plength) = 0;
+static MQTTTopicRegistry* MQTTClient::topicRegistry = nullptr;
+static void (*MQTTClient::handleCallback)(MQTTTopicHandle topic, uint8_t* payload, uint16_t plength) = nullptr;
 static bool MQTTClient::suback = false;
 static bool MQTTClient::connack = false;
+static uint8_t MQTTClient::connackCode = MQTT_CONNACK_NONE;
 static uint8_t MQTTClient::qosBufferHead = 0;
 static uint8_t MQTTClient::qosBufferTail = 0;
 static uint8_t MQTTClient::qosBufferCount = 0;
 static bool MQTTClient::fullQoSBuffer = false;
 static uint8_t MQTTClient::qosBufferLength = 16;
 static uint16_t* MQTTClient::qosBufferPacketIds;
+#if MQTT_FEATURES & MQTT_FEATURE_INBOUND_QUEUE
+static uint8_t* MQTTClient::inboundPool = nullptr;
+static uint16_t MQTTClient::inboundSlotSize = 0;
+static uint8_t MQTTClient::inboundSlotCount = 0;
+static bool (*MQTTClient::queueInbound)(const char* topic, uint16_t topicLen, MQTTTopicHandle handle, const uint8_t* payload, uint16_t payloadLen) = nullptr;
+static uint8_t MQTTClient::inboundHead = 0;
+static uint8_t MQTTClient::inboundTail = 0;
+static uint8_t MQTTClient::inboundCount = 0;
+static uint8_t MQTTClient::inboundHighWater = 0;
+static uint16_t MQTTClient::inboundDrops = 0;
+
+// Slot: délka topicu (2 B), délka payloadu (2 B), topic s '\0', payload.
+// Registrované téma se ukládá jen jako handle v místě délky (s příznakem), bez jména.
+#define MQTT_INBOUND_SLOT_HEADER 4
+#define MQTT_INBOUND_HANDLE_FLAG 0x8000
+
+static bool MQTTClient::QueueInbound(const char* topic, uint16_t topicLen, MQTTTopicHandle handle, const uint8_t* payload, uint16_t payloadLen)
+{
+  if(handle != MQTT_TOPIC_NONE)
+  {
+    topicLen = MQTT_INBOUND_HANDLE_FLAG | handle;
+  }
+  uint16_t topicSize = handle != MQTT_TOPIC_NONE ? 0 : topicLen + 1;
+  if(inboundCount == inboundSlotCount || MQTT_INBOUND_SLOT_HEADER + topicSize + payloadLen > inboundSlotSize)
+  {
+    inboundDrops = inboundDrops == 0xFFFF ? inboundDrops : inboundDrops + 1;
+    return false;
+  }
+  uint8_t* slot = inboundPool + (uint16_t)inboundHead * inboundSlotSize;
+  slot[0] = topicLen >> 8;
+  slot[1] = topicLen & 0xFF;
+  slot[2] = payloadLen >> 8;
+  slot[3] = payloadLen & 0xFF;
+  memcpy(slot + MQTT_INBOUND_SLOT_HEADER, topic, topicSize);
+  memcpy(slot + MQTT_INBOUND_SLOT_HEADER + topicSize, payload, payloadLen);
+  inboundHead = (inboundHead + 1) % inboundSlotCount;
+  inboundCount++;
+  inboundHighWater = max(inboundHighWater, inboundCount);
+  return true;
+}
+#endif
+#if MQTT_FEATURES & MQTT_FEATURE_COMPRESSION
+static MQTTCompressTopic MQTTClient::compressTopics[MQTT_COMPRESS_TOPICS];
+static uint8_t MQTTClient::compressTopicCount = 0;
+static uint8_t* MQTTClient::compressBuffer = nullptr;
+static uint16_t MQTTClient::compressBufferSize = 0;
+static MQTTCompressTopic* (*MQTTClient::findCompress)(const char* topic, MQTTTopicHandle handle) = nullptr;
+static uint16_t (*MQTTClient::encode)(const uint8_t* data, uint16_t length, uint8_t* out, uint16_t capacity) = nullptr;
+static bool (*MQTTClient::inflate)(MQTTCompressTopic* compressed, uint8_t** payload, uint16_t* length) = nullptr;
+#endif
 
 static void MQTTClient::DataReceived(uint8_t* data, int length)
 {
+  // Any inbound packet proves the link is alive
+  lastInActivity = millis();
+  if(rttProbePacket != 0 && (data[0]&0xF0) == rttProbePacket)
+  {
+    if(rttProbeWriting)
+    {
+      rttProbeAnswer = lastInActivity;
+    }
+    else
+    {
+      rtt.Sample(lastInActivity - rttProbeStart);
+    }
+    rttProbePacket = 0;
+  }
   switch(data[0]&0xF0)
   {
     case MQTTSUBACK:
@@ -21,78 +95,154 @@ static void MQTTClient::DataReceived(uint8_t* data, int length)
     break;
     case MQTTCONNACK: 
       connack = true;
+      connackCode = length >= 4 ? data[3] : MQTT_CONNACK_NONE;
     break;
     case MQTTPINGRESP: 
       MQTTClient::pingOutstanding = false;
     break;
     case MQTTPUBLISH:
-    uint8_t remainingLen = data[1];  // Pozor, toto je pouze první byte Remaining Length, viz poznámka níže
-    uint16_t topicLen = (data[2] << 8) | data[3];
+    // Remaining Length má 1 až 4 byty; délky paketu i tématu ověřil driver (DeliverFrame)
+    uint8_t headerLen = 2;
+    while((data[headerLen - 1] & 0x80) && headerLen < 5)
+    {
+      headerLen++;
+    }
+    uint16_t topicLen = (data[headerLen] << 8) | data[headerLen + 1];
 
-    // Posuň topic o 1 byte dozadu a přidej nulový terminátor
-    memmove(data + 3, data + 4, topicLen);
-    data[topicLen + 3] = '\0';
-    char* topic = (char*)(data + 3);
+    // Registrované téma se předá jako handle, řetězec se nepřipravuje
+    MQTTTopicHandle handle = handleCallback != nullptr ? topicRegistry->Find(data + headerLen + 2, topicLen) : MQTT_TOPIC_NONE;
+    char* topic = nullptr;
+    if(handle == MQTT_TOPIC_NONE)
+    {
+      // Posuň topic o 1 byte dozadu a přidej nulový terminátor
+      memmove(data + headerLen + 1, data + headerLen + 2, topicLen);
+      data[headerLen + 1 + topicLen] = '\0';
+      topic = (char*)(data + headerLen + 1);
+    }
 
     // Zjisti QoS z fixed header (bit 1 a 2)
     uint8_t qos = (data[0] >> 1) & 0x03;
 
     uint8_t* payload;
-    uint16_t payloadOffset = 4 + topicLen;
+    uint16_t payloadOffset = headerLen + 2 + topicLen;
 
+    uint16_t packetId = 0;
     if (qos > 0) 
     {
       // Packet Identifier je 2 bajty za topicem
-      uint16_t packetId = (data[payloadOffset] << 8) | data[payloadOffset + 1];
-      if(qosBufferHead == qosBufferTail && qosBufferCount != 0)
+      packetId = (data[payloadOffset] << 8) | data[payloadOffset + 1];
+#if MQTT_FEATURES & MQTT_FEATURE_QOS1
+      if(qosBufferLength > 0 && qosBufferHead == qosBufferTail && qosBufferCount != 0)
       {
         fullQoSBuffer = true;
         return;
       }
-      qosBufferPacketIds[qosBufferHead] = packetId;
-      qosBufferHead = (qosBufferHead + 1) % qosBufferLength;
-      qosBufferCount++;
+#endif
       payloadOffset += 2;
     }
 
     payload = data + payloadOffset;
 
-    // Vypočítat délku payloadu správně (nutné správně dekódovat Remaining Length)
-    uint16_t payloadLen = remainingLen - (payloadOffset - 2); // -2 protože Remaining Length počítá od data[2]
+    uint16_t payloadLen = length - payloadOffset;
 
-    // Zavolat callback s topicem, payloadem, délkou payloadu a packetId
-    callback(topic, payload, payloadLen);
+    bool deliver = true;
+#if MQTT_FEATURES & MQTT_FEATURE_COMPRESSION
+    // Poškozená komprimovaná zpráva se potvrdí a zahodí, opakované doručení by nepomohlo
+    MQTTCompressTopic* compressed = findCompress != nullptr ? findCompress(topic, handle) : nullptr;
+    if(compressed != nullptr)
+    {
+      deliver = inflate(compressed, &payload, &payloadLen);
+    }
+#endif
+#if MQTT_FEATURES & MQTT_FEATURE_INBOUND_QUEUE
+    // Zpráva, která se nevejde do fronty, se nepotvrdí
+    if(deliver && inboundSlotCount > 0 && !queueInbound(topic, topicLen, handle, payload, payloadLen))
+    {
+      return;
+    }
+#endif
+#if MQTT_FEATURES & MQTT_FEATURE_QOS1
+    if (qos > 0 && qosBufferLength > 0)
+    {
+      qosBufferPacketIds[qosBufferHead] = packetId;
+      qosBufferHead = (qosBufferHead + 1) % qosBufferLength;
+      qosBufferCount++;
+    }
+#endif
+    if(!deliver)
+    {
+      return;
+    }
+#if MQTT_FEATURES & MQTT_FEATURE_INBOUND_QUEUE
+    if(inboundSlotCount == 0)
+#endif
+    {
+      // Zavolat callback s topicem, payloadem, délkou payloadu a packetId
+      if(handle != MQTT_TOPIC_NONE)
+      {
+        handleCallback(handle, payload, payloadLen);
+      }
+      else
+      {
+        callback(topic, payload, payloadLen);
+      }
+    }
     break;
     
   }
 }
 
 MQTTClient::MQTTClient(EspDrv *espDriver, void(*callback)(char* topic, uint8_t* payload, uint16_t plength), uint8_t pQosBufferLength = 16)
+{
+  InitState(espDriver, callback);
+  this->buffer = new uint8_t[bufferSize];
+#if MQTT_FEATURES & MQTT_FEATURE_QOS1
+  qosBufferPacketIds = new uint16_t[pQosBufferLength];
+  qosBufferLength = pQosBufferLength;
+#else
+  qosBufferLength = 0;
+#endif
+}
+
+// Veškerá paměť od volajícího (MQTTClientStatic), nic se nealokuje
+MQTTClient::MQTTClient(EspDrv *espDriver, void(*callback)(char* topic, uint8_t* payload, uint16_t plength),
+  uint8_t* buffer, uint16_t bufferSize, uint16_t* qosBuffer, uint8_t qosBufferLength, uint8_t* connectStorage, uint16_t connectStorageSize, uint8_t features)
+{
+  InitState(espDriver, callback);
+  this->buffer = buffer;
+  this->bufferSize = bufferSize;
+  this->features = features;
+  qosBufferPacketIds = qosBuffer;
+  MQTTClient::qosBufferLength = qosBufferLength;
+  connectPacket = connectStorage;
+  connectPacketCapacity = connectStorageSize;
+  ownsConnectPacket = false;
+}
+
+void MQTTClient::InitState(EspDrv *espDriver, void(*callback)(char* topic, uint8_t* payload, uint16_t plength))
 {
   this->client = espDriver;
   this->client->DataReceived = &DataReceived;
-  this->buffer = new uint8_t[bufferSize];
   this->callback = callback;
   fullQoSBuffer = false;
   qosBufferHead = qosBufferTail = 0;
   qosBufferCount = 0;
-  qosBufferPacketIds = new uint16_t[pQosBufferLength];
-  qosBufferLength = pQosBufferLength;
 }
 
 bool MQTTClient::Connect(MQTTConnectData mqttConnectData)
 {
   this->client->TCPConnect(mqttConnectData.url, mqttConnectData.port);
-  this->keepAlive = mqttConnectData.keepAlive;
-  fullQoSBuffer = false;
-  qosBufferHead = qosBufferTail = 0;
-  qosBufferCount = 0;
-  return this->Login(mqttConnectData);
+  if(!this->PrepareConnect(mqttConnectData))
+  {
+    return false;
+  }
+  return this->Login();
 }
 
-bool MQTTClient::Login(MQTTConnectData mqttConnectData)
+bool MQTTClient::PrepareConnect(MQTTConnectData mqttConnectData)
 {
-  connack = false;
+  // V úsporném režimu modulu delší, PINGREQ budí rádio
+  this->keepAlive = this->client->GetKeepAlive(mqttConnectData.keepAlive);
   uint16_t length = MQTT_MAX_HEADER_SIZE;
   unsigned int j;
 
@@ -108,6 +258,20 @@ bool MQTTClient::Login(MQTTConnectData mqttConnectData)
     this->buffer[length++] = d[j];
   }
 
+#if MQTT_FEATURES & MQTT_FEATURE_WILL
+  if(!(features & MQTT_FEATURE_WILL))
+#endif
+  {
+    mqttConnectData.willTopic = NULL;
+  }
+#if MQTT_FEATURES & MQTT_FEATURE_AUTH
+  if(!(features & MQTT_FEATURE_AUTH))
+#endif
+  {
+    mqttConnectData.user = NULL;
+    mqttConnectData.pass = NULL;
+  }
+
   uint8_t v;
   if (mqttConnectData.willTopic) 
   {
@@ -136,6 +300,7 @@ bool MQTTClient::Login(MQTTConnectData mqttConnectData)
 
   CHECK_STRING_LENGTH(length,mqttConnectData.id)
   length = WriteString(mqttConnectData.id,this->buffer,length);
+#if MQTT_FEATURES & MQTT_FEATURE_WILL
   if (mqttConnectData.willTopic) 
   {
     CHECK_STRING_LENGTH(length,mqttConnectData.willTopic)
@@ -143,7 +308,9 @@ bool MQTTClient::Login(MQTTConnectData mqttConnectData)
     CHECK_STRING_LENGTH(length,mqttConnectData.willMessage)
     length = WriteString(mqttConnectData.willMessage,this->buffer,length);
   }
+#endif
 
+#if MQTT_FEATURES & MQTT_FEATURE_AUTH
   if(mqttConnectData.user != NULL) 
   {
     CHECK_STRING_LENGTH(length,mqttConnectData.user)
@@ -154,7 +321,51 @@ bool MQTTClient::Login(MQTTConnectData mqttConnectData)
       length = WriteString(mqttConnectData.pass,this->buffer,length);
     }
   }
-  Write(MQTTCONNECT,this->buffer,length-MQTT_MAX_HEADER_SIZE);
+#endif
+  // CONNECT se při každém pokusu o připojení posílá beze změny, uloží se hotový paket
+  uint8_t hlen = BuildHeader(MQTTCONNECT, this->buffer, length-MQTT_MAX_HEADER_SIZE);
+  uint16_t packetLength = length-MQTT_MAX_HEADER_SIZE+hlen;
+  if(!ownsConnectPacket)
+  {
+    if(packetLength > connectPacketCapacity)
+    {
+      connectPacketLength = 0;
+      return false;
+    }
+    connectPacketLength = packetLength;
+  }
+  else if(packetLength != connectPacketLength)
+  {
+    delete[] connectPacket;
+    connectPacket = new uint8_t[packetLength];
+    if(!connectPacket)
+    {
+      connectPacketLength = 0;
+      return false;
+    }
+    connectPacketLength = packetLength;
+  }
+  memcpy(connectPacket, this->buffer+(MQTT_MAX_HEADER_SIZE-hlen), packetLength);
+  return true;
+}
+
+bool MQTTClient::Login()
+{
+  if(connectPacketLength == 0)
+  {
+    return false;
+  }
+  MQTTClient::pingOutstanding = false;
+  fullQoSBuffer = false;
+  qosBufferHead = qosBufferTail = 0;
+  qosBufferCount = 0;
+  connack = false;
+  connackCode = MQTT_CONNACK_NONE;
+  // Write čeká na SEND OK a CONNACK může přijít dřív, měření začíná před zápisem
+  StartRttProbe(MQTTCONNACK);
+  this->client->Write(connectPacket, connectPacketLength);
+  SentRttProbe();
+  OutActivity(millis());
   unsigned long t = millis();
   isConnected = false;
   while(!connack && millis() - t < 10000)
@@ -162,10 +373,97 @@ bool MQTTClient::Login(MQTTConnectData mqttConnectData)
     wdt_reset();
     client->Loop();
   }
-  isConnected = client->GetClientStatus() == CL_CONNECTED;
+  if(connack && connackCode != MQTT_CONNACK_ACCEPTED)
+  {
+    // Broker připojení odmítl (verze, id, jméno/heslo) a spojení sám zavírá
+    this->client->Close();
+  }
+  isConnected = connack && connackCode == MQTT_CONNACK_ACCEPTED && client->GetClientStatus() == CL_CONNECTED;
+  lastInActivity = millis();
   return isConnected;
 }
 
+bool MQTTClient::Resume()
+{
+  // TCP spojení přežilo restart MCU, relace u brokera se ověří pingem
+  isConnected = false;
+  if(connectPacketLength == 0 || client->GetClientStatus() != CL_CONNECTED)
+  {
+    return false;
+  }
+  SendPing(millis());
+  unsigned long t = millis();
+  while(MQTTClient::pingOutstanding && millis() - t < GetProbeTimeout())
+  {
+    wdt_reset();
+    client->Loop();
+  }
+  if(MQTTClient::pingOutstanding)
+  {
+    MQTTClient::pingOutstanding = false;
+    this->client->Close();
+    return false;
+  }
+  isConnected = true;
+  return isConnected;
+}
+
+#if MQTT_FEATURES & MQTT_FEATURE_INBOUND_QUEUE
+bool MQTTClient::EnableInboundQueue(uint8_t slotCount, uint16_t slotSize)
+{
+  uint8_t* pool = new uint8_t[(uint16_t)slotCount * slotSize];
+  if(!pool)
+  {
+    return false;
+  }
+  EnableInboundQueue(pool, (uint16_t)slotCount * slotSize, slotSize);
+  return true;
+}
+
+void MQTTClient::EnableInboundQueue(uint8_t* storage, uint16_t storageSize, uint16_t slotSize)
+{
+  inboundPool = storage;
+  inboundSlotSize = slotSize;
+  inboundSlotCount = min(storageSize / slotSize, (uint16_t)255);
+  inboundHead = inboundTail = inboundCount = 0;
+  queueInbound = QueueInbound;
+}
+
+uint8_t MQTTClient::Poll()
+{
+  // Slot se uvolní až po callbacku, příjem během publikování v callbacku ho nepřepíše
+  uint8_t delivered = 0;
+  while(inboundCount > 0)
+  {
+    uint8_t* slot = inboundPool + (uint16_t)inboundTail * inboundSlotSize;
+    uint16_t topicLen = (slot[0] << 8) | slot[1];
+    uint16_t payloadLen = (slot[2] << 8) | slot[3];
+    if(topicLen & MQTT_INBOUND_HANDLE_FLAG)
+    {
+      handleCallback(topicLen & 0xFF, slot + MQTT_INBOUND_SLOT_HEADER, payloadLen);
+    }
+    else
+    {
+      callback((char*)(slot + MQTT_INBOUND_SLOT_HEADER), slot + MQTT_INBOUND_SLOT_HEADER + topicLen + 1, payloadLen);
+    }
+    inboundTail = (inboundTail + 1) % inboundSlotCount;
+    inboundCount--;
+    delivered++;
+  }
+  return delivered;
+}
+
+uint8_t MQTTClient::GetInboundHighWater()
+{
+  return inboundHighWater;
+}
+
+uint16_t MQTTClient::GetInboundDrops()
+{
+  return inboundDrops;
+}
+#endif
+
 uint16_t MQTTClient::WriteString(const char* string, uint8_t* buf, uint16_t pos)
 {
   const char* idp = string;
@@ -202,6 +500,10 @@ void MQTTClient::Subscribe(const char *topic, uint8_t qos)
   {
     return false;
   }
+  if(!(features & MQTT_FEATURE_QOS1))
+  {
+    qos = 0;
+  }
   if (this->bufferSize < 9 + topicLength) 
   {
     // Too long
@@ -218,7 +520,9 @@ void MQTTClient::Subscribe(const char *topic, uint8_t qos)
   this->buffer[length++] = (nextMsgId & 0xFF);
   length = WriteString((char*)topic, this->buffer,length);
   this->buffer[length++] = qos;
+  StartRttProbe(MQTTSUBACK);
   Write(MQTTSUBSCRIBE|MQTTQOS1,this->buffer,length-MQTT_MAX_HEADER_SIZE);
+  SentRttProbe();
   unsigned long t = millis();
   while(!MQTTClient::suback && millis() - t < 3000)
   {
@@ -250,7 +554,7 @@ bool MQTTClient::Publish(const char* topic, const uint8_t* payload, unsigned int
     Serial.println("Not connected");
     return false;
   }
-  if (this->bufferSize < MQTT_MAX_HEADER_SIZE + 2+strnlen(topic, this->bufferSize) + plength) 
+  if (this->bufferSize < MQTT_MAX_HEADER_SIZE + 2+strnlen(topic, this->bufferSize)) 
   {
     Serial.println("Small buffer size");
     return false;
@@ -260,12 +564,336 @@ bool MQTTClient::Publish(const char* topic, const uint8_t* payload, unsigned int
   length = WriteString(topic,this->buffer,length);
 
   // Add payload
-  uint16_t i;
-  for (i=0;i<plength;i++) 
+  length = WritePayload(length, payload, plength, topic, MQTT_TOPIC_NONE);
+  if(length == 0)
   {
-    this->buffer[length++] = payload[i];
+    Serial.println("Small buffer size");
+    return false;
   }
+  return SendPublish(length, retained);
+}
+
+void MQTTClient::SetTopicRegistry(MQTTTopicRegistry* registry, void(*handleCallback)(MQTTTopicHandle topic, uint8_t* payload, uint16_t plength))
+{
+  topicRegistry = registry;
+  MQTTClient::handleCallback = registry != nullptr ? handleCallback : nullptr;
+}
 
+bool MQTTClient::Publish(MQTTTopicHandle topic, const char* payload)
+{
+  return Publish(topic, (const uint8_t*)payload, payload ? strnlen(payload, this->bufferSize) : 0, false);
+}
+
+bool MQTTClient::Publish(MQTTTopicHandle topic, const uint8_t* payload, unsigned int plength, boolean retained)
+{
+  if(!isConnected)
+  {
+    Serial.println("Not connected");
+    return false;
+  }
+  if(topicRegistry == nullptr || topic >= topicRegistry->GetCount())
+  {
+    return false;
+  }
+  // Téma je v registru už zakódované (délka + jméno), jen se zkopíruje z flash
+  uint16_t topicLength = topicRegistry->GetWireLength(topic);
+  if (this->bufferSize < MQTT_MAX_HEADER_SIZE + topicLength) 
+  {
+    Serial.println("Small buffer size");
+    return false;
+  }
+  uint16_t length = MQTT_MAX_HEADER_SIZE;
+  memcpy_P(this->buffer + length, topicRegistry->GetWire(topic), topicLength);
+  length += topicLength;
+  length = WritePayload(length, payload, plength, nullptr, topic);
+  if(length == 0)
+  {
+    Serial.println("Small buffer size");
+    return false;
+  }
+  return SendPublish(length, retained);
+}
+
+MQTTPayloadWriter MQTTClient::BeginPublish(const char* topic, MQTTPayloadFormat format)
+{
+  publishStart = 0;
+  if(!isConnected)
+  {
+    Serial.println("Not connected");
+    return MQTTPayloadWriter(nullptr, 0, format);
+  }
+  if (this->bufferSize < MQTT_MAX_HEADER_SIZE + 2 + strnlen(topic, this->bufferSize)) 
+  {
+    Serial.println("Small buffer size");
+    return MQTTPayloadWriter(nullptr, 0, format);
+  }
+  publishStart = WriteString(topic, this->buffer, MQTT_MAX_HEADER_SIZE);
+  return StartPayload(format, topic, MQTT_TOPIC_NONE);
+}
+
+MQTTPayloadWriter MQTTClient::BeginPublish(MQTTTopicHandle topic, MQTTPayloadFormat format)
+{
+  publishStart = 0;
+  if(!isConnected)
+  {
+    Serial.println("Not connected");
+    return MQTTPayloadWriter(nullptr, 0, format);
+  }
+  if(topicRegistry == nullptr || topic >= topicRegistry->GetCount())
+  {
+    return MQTTPayloadWriter(nullptr, 0, format);
+  }
+  uint16_t topicLength = topicRegistry->GetWireLength(topic);
+  if (this->bufferSize < MQTT_MAX_HEADER_SIZE + topicLength) 
+  {
+    Serial.println("Small buffer size");
+    return MQTTPayloadWriter(nullptr, 0, format);
+  }
+  memcpy_P(this->buffer + MQTT_MAX_HEADER_SIZE, topicRegistry->GetWire(topic), topicLength);
+  publishStart = MQTT_MAX_HEADER_SIZE + topicLength;
+  return StartPayload(format, nullptr, topic);
+}
+
+MQTTPayloadWriter MQTTClient::StartPayload(MQTTPayloadFormat format, const char* topic, MQTTTopicHandle handle)
+{
+#if MQTT_FEATURES & MQTT_FEATURE_COMPRESSION
+  // Writer píše za hlavičku MQTT_COMPRESS_NONE, EndPublish payload případně zkomprimuje
+  publishCompress = findCompress != nullptr ? findCompress(topic, handle) : nullptr;
+  if(publishCompress != nullptr)
+  {
+    if(publishStart >= this->bufferSize)
+    {
+      Serial.println("Small buffer size");
+      publishStart = 0;
+      return MQTTPayloadWriter(nullptr, 0, format);
+    }
+    this->buffer[publishStart++] = MQTT_COMPRESS_NONE;
+  }
+#endif
+  return MQTTPayloadWriter(this->buffer + publishStart, this->bufferSize - publishStart, format);
+}
+
+bool MQTTClient::EndPublish(MQTTPayloadWriter& payload, boolean retained)
+{
+  uint16_t start = publishStart;
+  publishStart = 0;
+#if MQTT_FEATURES & MQTT_FEATURE_COMPRESSION
+  MQTTCompressTopic* compressed = publishCompress;
+  publishCompress = nullptr;
+#endif
+  // Writer musí patřit k poslednímu BeginPublish
+  if(start == 0 || payload.GetBuffer() != this->buffer + start)
+  {
+    return false;
+  }
+  if(!payload.IsValid())
+  {
+    Serial.println(payload.GetLength() > this->bufferSize - start ? "Small buffer size" : "Invalid payload");
+    return false;
+  }
+  uint16_t length = payload.GetLength();
+#if MQTT_FEATURES & MQTT_FEATURE_COMPRESSION
+  if(compressed != nullptr)
+  {
+    unsigned long t = micros();
+    uint16_t packed = compressBuffer != nullptr ? encode(this->buffer + start, length, compressBuffer, compressBufferSize) : 0;
+    compressed->stats.encodeMicros += micros() - t;
+    CountEncoded(compressed->stats, length, packed);
+    if(packed > 0)
+    {
+      // Komprimovaná data i s hlavičkou přepíšou MQTT_COMPRESS_NONE a payload
+      memcpy(this->buffer + start - 1, compressBuffer, packed);
+      return SendPublish(start - 1 + packed, retained);
+    }
+  }
+#endif
+  return SendPublish(start + length, retained);
+}
+
+uint16_t MQTTClient::WritePayload(uint16_t pos, const uint8_t* payload, unsigned int plength, const char* topic, MQTTTopicHandle handle)
+{
+#if MQTT_FEATURES & MQTT_FEATURE_COMPRESSION
+  MQTTCompressTopic* compressed = findCompress != nullptr ? findCompress(topic, handle) : nullptr;
+  if(compressed != nullptr)
+  {
+    // Komprimuje se rovnou do TX bufferu; zmenšený payload se vejde, i když původní ne
+    unsigned long t = micros();
+    uint16_t packed = encode(payload, plength, this->buffer + pos, this->bufferSize - pos);
+    compressed->stats.encodeMicros += micros() - t;
+    if(packed == 0 && (unsigned int)(this->bufferSize - pos) < 1 + plength)
+    {
+      return 0;
+    }
+    CountEncoded(compressed->stats, plength, packed);
+    if(packed > 0)
+    {
+      return pos + packed;
+    }
+    this->buffer[pos++] = MQTT_COMPRESS_NONE;
+  }
+#endif
+  if((unsigned int)(this->bufferSize - pos) < plength)
+  {
+    return 0;
+  }
+  memcpy(this->buffer + pos, payload, plength);
+  return pos + plength;
+}
+
+#if MQTT_FEATURES & MQTT_FEATURE_COMPRESSION
+bool MQTTClient::EnableCompression(const char* topic)
+{
+  return AddCompressTopic(topic, MQTT_TOPIC_NONE);
+}
+
+bool MQTTClient::EnableCompression(MQTTTopicHandle topic)
+{
+  return AddCompressTopic(nullptr, topic);
+}
+
+bool MQTTClient::AddCompressTopic(const char* topic, MQTTTopicHandle handle)
+{
+  if(FindCompressTopic(topic, handle) != nullptr)
+  {
+    return true;
+  }
+  if(compressTopicCount == MQTT_COMPRESS_TOPICS || (topic == nullptr && handle == MQTT_TOPIC_NONE))
+  {
+    return false;
+  }
+  MQTTCompressTopic& entry = compressTopics[compressTopicCount++];
+  entry.topic = topic;
+  entry.handle = handle;
+  entry.stats = MQTTCompressStats();
+  findCompress = FindCompressTopic;
+  encode = MQTTCompress::Encode;
+  inflate = Inflate;
+  return true;
+}
+
+void MQTTClient::SetCompressBuffer(uint8_t* buffer, uint16_t size)
+{
+  compressBuffer = buffer;
+  compressBufferSize = buffer != nullptr ? size : 0;
+}
+
+const MQTTCompressStats* MQTTClient::GetCompressStats(const char* topic)
+{
+  MQTTCompressTopic* compressed = FindCompressTopic(topic, MQTT_TOPIC_NONE);
+  return compressed != nullptr ? &compressed->stats : nullptr;
+}
+
+const MQTTCompressStats* MQTTClient::GetCompressStats(MQTTTopicHandle topic)
+{
+  MQTTCompressTopic* compressed = FindCompressTopic(nullptr, topic);
+  return compressed != nullptr ? &compressed->stats : nullptr;
+}
+
+static MQTTCompressTopic* MQTTClient::FindCompressTopic(const char* topic, MQTTTopicHandle handle)
+{
+  // Téma z registru se porovná i se jmény zapnutými přes EnableCompression(const char*)
+  const char* name = topic;
+  uint16_t length = 0;
+  bool flash = false;
+  if(handle != MQTT_TOPIC_NONE)
+  {
+    name = nullptr;
+    if(topicRegistry != nullptr && handle < topicRegistry->GetCount())
+    {
+      name = (const char*)topicRegistry->GetWire(handle) + 2;
+      length = topicRegistry->GetWireLength(handle) - 2;
+      flash = true;
+    }
+  }
+  else if(topic != nullptr)
+  {
+    length = strlen(topic);
+  }
+  for(uint8_t i = 0; i < compressTopicCount; i++)
+  {
+    MQTTCompressTopic& entry = compressTopics[i];
+    if(entry.topic == nullptr ? handle != MQTT_TOPIC_NONE && entry.handle == handle : name != nullptr && TopicMatches(entry.topic, name, length, flash))
+    {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+static bool MQTTClient::TopicMatches(const char* filter, const char* topic, uint16_t length, bool flash)
+{
+  for(uint16_t i = 0; filter[i] != '\0'; i++)
+  {
+    // '#' je zástupný jen jako celá poslední úroveň ("#", "log/#"), jinak se porovná jako znak
+    if(filter[i] == '#' && filter[i + 1] == '\0' && (i == 0 || filter[i - 1] == '/'))
+    {
+      return true;
+    }
+    if(i == length)
+    {
+      // "log/#" pokrývá i samotné "log"
+      return strcmp(filter + i, "/#") == 0;
+    }
+    if(filter[i] != (flash ? (char)pgm_read_byte(topic + i) : topic[i]))
+    {
+      return false;
+    }
+  }
+  return strlen(filter) == length;
+}
+
+static void MQTTClient::CountEncoded(MQTTCompressStats& stats, uint16_t raw, uint16_t packed)
+{
+  stats.rawBytes += raw;
+  if(packed > 0)
+  {
+    stats.encoded++;
+    stats.wireBytes += packed;
+  }
+  else
+  {
+    stats.stored++;
+    stats.wireBytes += raw + 1;
+  }
+}
+
+static bool MQTTClient::Inflate(MQTTCompressTopic* compressed, uint8_t** payload, uint16_t* length)
+{
+  MQTTCompressStats& stats = compressed->stats;
+  // Prázdný payload (např. smazání retained zprávy) je bez hlavičky
+  if(*length == 0)
+  {
+    return true;
+  }
+  stats.wireBytes += *length;
+  if(**payload == MQTT_COMPRESS_NONE)
+  {
+    // Nekomprimovaný payload se jen přeskočí za hlavičku, bez kopírování
+    (*payload)++;
+    (*length)--;
+    stats.rawBytes += *length;
+    stats.decoded++;
+    return true;
+  }
+  unsigned long t = micros();
+  uint16_t inflated = 0;
+  bool result = compressBuffer != nullptr && MQTTCompress::Decode(*payload, *length, compressBuffer, compressBufferSize, &inflated);
+  stats.decodeMicros += micros() - t;
+  if(!result)
+  {
+    stats.decodeErrors++;
+    return false;
+  }
+  stats.rawBytes += inflated;
+  stats.decoded++;
+  *payload = compressBuffer;
+  *length = inflated;
+  return true;
+}
+#endif
+
+bool MQTTClient::SendPublish(uint16_t length, boolean retained)
+{
   // Write the header
   uint8_t header = MQTTPUBLISH;
   if (retained) 
@@ -273,6 +901,10 @@ bool MQTTClient::Publish(const char* topic, const uint8_t* payload, unsigned int
     header |= 1;
   }
   bool result = Write(header,this->buffer,length-MQTT_MAX_HEADER_SIZE);
+  if(result && firstPublishTime == 0)
+  {
+    firstPublishTime = millis();
+  }
   return result;
 }
 
@@ -308,7 +940,7 @@ bool MQTTClient::Write(uint8_t header, uint8_t* buf, uint16_t length)
     return true;
 #else
     bool result = client->Write(buf+(MQTT_MAX_HEADER_SIZE-hlen),length+hlen);
-    lastOutActivity = millis();
+    OutActivity(millis());
     return result;
 #endif
 }
@@ -354,6 +986,15 @@ bool MQTTClient::Loop()
 {
   unsigned long currentMillis = millis();
   IsConnected();
+  // IsConnected se ptá modulu (AT+CIPSTATUS), jakmile vyprší platnost posledního stavu.
+  // Termín se mění, jen když se stav právě zjistil (dotazem nebo příchozími daty).
+  unsigned long deadline = this->client->GetStatusDeadline();
+  if(deadline != statusDeadline)
+  {
+    statusDeadline = deadline;
+    timers.Set(MQTT_TIMER_STATUS, deadline);
+  }
+#if MQTT_FEATURES & MQTT_FEATURE_QOS1
   if(isConnected)
   {
     while(qosBufferHead != qosBufferTail)
@@ -367,26 +1008,28 @@ bool MQTTClient::Loop()
       this->client->Close();
     }
   }
-  if(currentMillis - lastOutActivity >= keepAlive * 1000 && keepAlive > 0 && isConnected)
+#endif
+  if(keepAlive > 0 && isConnected)
   {
     if(MQTTClient::pingOutstanding)
     {
-      isConnected = false;
-      this->Disconnect();
-      return isConnected;
-    }
-    else
-    {
-      if(isConnected)
+      // Inbound traffic after the PINGREQ proves liveness as well
+      unsigned long reference = (long)(lastInActivity - pingSent) > 0 ? lastInActivity : pingSent;
+      if(currentMillis - reference > GetProbeTimeout())
       {
-        //Send ping request
-        MQTTClient::pingOutstanding = true;
-        lastOutActivity = currentMillis;
-        lastInActivity = currentMillis;
-        buffer[0] = MQTTPINGREQ;
-        buffer[1] = 0;
-        this->client->Write(buffer, 2);
+        MQTTClient::pingOutstanding = false;
+        isConnected = false;
+        deadLinkCount++;
+        this->client->Close();
+        return isConnected;
       }
+      // Příchozí data termín posunula
+      timers.Set(MQTT_TIMER_PING_TIMEOUT, reference + GetProbeTimeout() + 1);
+    }
+    else if(currentMillis - lastOutActivity >= keepAlive * 1000UL
+      || ((long)(lastOutActivity - lastInActivity) > 0 && currentMillis - lastInActivity >= ProbeInterval()))
+    {
+      SendPing(currentMillis);
     }
   }
   this->client->Loop();
@@ -398,4 +1041,124 @@ bool MQTTClient::IsConnected()
   uint8_t status = this->client->GetClientStatus();
   isConnected = status == CL_CONNECTED;
   return isConnected;
+}
+
+void MQTTClient::SendPing(unsigned long currentMillis)
+{
+  MQTTClient::pingOutstanding = true;
+  OutActivity(currentMillis);
+  buffer[0] = MQTTPINGREQ;
+  buffer[1] = 0;
+  // PINGRESP může přijít ještě před SEND OK, tedy během Write
+  pingSent = millis();
+  StartRttProbe(MQTTPINGRESP);
+  this->client->Write(buffer, 2);
+  SentRttProbe();
+  timers.Set(MQTT_TIMER_PING_TIMEOUT, pingSent + GetProbeTimeout() + 1);
+}
+
+void MQTTClient::OutActivity(unsigned long now)
+{
+  lastOutActivity = now;
+  if(keepAlive > 0)
+  {
+    timers.Set(MQTT_TIMER_KEEPALIVE, now + keepAlive * 1000UL);
+    timers.Set(MQTT_TIMER_PROBE, lastInActivity + ProbeInterval());
+  }
+}
+
+bool MQTTClient::TimerActive(uint8_t timer)
+{
+  switch(timer)
+  {
+    case MQTT_TIMER_KEEPALIVE:
+      return keepAlive > 0 && isConnected;
+    case MQTT_TIMER_PROBE:
+      return keepAlive > 0 && isConnected && !MQTTClient::pingOutstanding && (long)(lastOutActivity - lastInActivity) > 0;
+    case MQTT_TIMER_PING_TIMEOUT:
+      return isConnected && MQTTClient::pingOutstanding;
+    case MQTT_TIMER_STATUS:
+      return true;
+  }
+  return false;
+}
+
+unsigned long MQTTClient::NextDeadline()
+{
+#if MQTT_FEATURES & MQTT_FEATURE_QOS1
+  // PUBACKy se odesílají v Loop
+  if(qosBufferHead != qosBufferTail || fullQoSBuffer)
+  {
+    return 0;
+  }
+#endif
+#if MQTT_FEATURES & MQTT_FEATURE_INBOUND_QUEUE
+  if(inboundCount > 0)
+  {
+    return 0;
+  }
+#endif
+  while(!timers.Empty() && !TimerActive(timers.FirstId()))
+  {
+    timers.Cancel(timers.FirstId());
+  }
+  return min(timers.Remaining(millis()), client->NextDeadline());
+}
+
+// Volá se před Write: odpověď často předběhne SEND OK a přijde ještě během zápisu
+void MQTTClient::StartRttProbe(uint8_t responsePacket)
+{
+  rttProbeStart = millis();
+  rttProbePacket = responsePacket;
+  rttProbeWriting = true;
+}
+
+// Po Write: měří se od začátku zápisu dat, bez čekání na modul a na výzvu '>'
+void MQTTClient::SentRttProbe()
+{
+  rttProbeWriting = false;
+  unsigned long start = client->GetDataStart();
+  if((long)(start - rttProbeStart) < 0)
+  {
+    // Data se nezapsala, čeká se na odpověď od začátku pokusu
+    start = rttProbeStart;
+  }
+  if(rttProbePacket == 0)
+  {
+    rtt.Sample((long)(rttProbeAnswer - start) > 0 ? rttProbeAnswer - start : 0);
+    return;
+  }
+  rttProbeStart = start;
+}
+
+unsigned long MQTTClient::GetProbeTimeout()
+{
+  unsigned long maxTimeout = max(keepAlive * 500UL, (unsigned long)MQTT_PROBE_TIMEOUT_MIN);
+  return rtt.Timeout(MQTT_PROBE_TIMEOUT_DEFAULT, MQTT_PROBE_TIMEOUT_MIN, maxTimeout);
+}
+
+unsigned long MQTTClient::ProbeInterval()
+{
+  unsigned long interval = max(GetProbeTimeout() * MQTT_PROBE_INTERVAL_FACTOR, (unsigned long)MQTT_PROBE_INTERVAL_MIN);
+  return min(interval, keepAlive * 1000UL);
+}
+
+const RttEstimator& MQTTClient::GetRtt()
+{
+  return rtt;
+}
+
+unsigned long MQTTClient::GetFirstPublishTime()
+{
+  return firstPublishTime;
+}
+
+uint16_t MQTTClient::GetDeadLinkCount()
+{
+  return deadLinkCount;
+}
+
+uint8_t MQTTClient::GetConnectReturnCode()
+{
+  return connackCode;
 }
\ No newline at end of file
@@ -2,6 +2,10 @@
 #define __MQTTCLIENT_H
 
 #include "EspDrv.h"
+#include "RttEstimator.h"
+#include "MQTTTopicRegistry.h"
+#include "MQTTPayload.h"
+#include "MQTTCompress.h"
 
 #define MQTT_VERSION_3_1      3
 #define MQTT_VERSION_3_1_1    4
@@ -16,8 +20,55 @@
 #define MQTT_KEEPALIVE 15
 #endif
 
+// Dead link detection. PINGREQ is answered within srtt + 4 * rttvar (clamped to
+// <MQTT_PROBE_TIMEOUT_MIN, keepAlive / 2>), otherwise the connection is closed.
+#ifndef MQTT_PROBE_TIMEOUT_MIN
+#define MQTT_PROBE_TIMEOUT_MIN 500
+#endif
+
+#ifndef MQTT_PROBE_TIMEOUT_DEFAULT
+#define MQTT_PROBE_TIMEOUT_DEFAULT 3000
+#endif
+
+// While publishing without hearing from the broker a probe is sent every
+// MQTT_PROBE_INTERVAL_FACTOR probe timeouts (at least MQTT_PROBE_INTERVAL_MIN, at most keepAlive).
+#ifndef MQTT_PROBE_INTERVAL_MIN
+#define MQTT_PROBE_INTERVAL_MIN 2000
+#endif
+
+#ifndef MQTT_PROBE_INTERVAL_FACTOR
+#define MQTT_PROBE_INTERVAL_FACTOR 4
+#endif
+
+// Časovače pro NextDeadline
+#define MQTT_TIMER_KEEPALIVE 0
+#define MQTT_TIMER_PROBE 1
+#define MQTT_TIMER_PING_TIMEOUT 2
+#define MQTT_TIMER_STATUS 3
+
+// Velikost TX bufferu (pro MQTTClientStatic se zadává parametrem šablony)
+#ifndef MQTT_BUFFER_SIZE
+#define MQTT_BUFFER_SIZE 256
+#endif
+
+// MQTT_FEATURES : features compiled into the library (e.g. -DMQTT_FEATURES=MQTT_FEATURE_QOS1)
+#define MQTT_FEATURE_WILL           0x01
+#define MQTT_FEATURE_AUTH           0x02
+#define MQTT_FEATURE_QOS1           0x04
+#define MQTT_FEATURE_INBOUND_QUEUE  0x08
+#define MQTT_FEATURE_COMPRESSION    0x10
+#define MQTT_FEATURES_ALL           0x1F
+#ifndef MQTT_FEATURES
+#define MQTT_FEATURES MQTT_FEATURES_ALL
+#endif
+
 #define MQTT_MAX_HEADER_SIZE 5
 
+// Počet témat s kompresí payloadu (EnableCompression)
+#ifndef MQTT_COMPRESS_TOPICS
+#define MQTT_COMPRESS_TOPICS 4
+#endif
+
 #define CHECK_STRING_LENGTH(l,s) if (l+2+strnlen(s, this->bufferSize) > this->bufferSize) {return false;}
 
 #define MQTTCONNECT     1 << 4  // Client request to connect to Server
@@ -36,6 +87,10 @@
 #define MQTTDISCONNECT  14 << 4 // Client is Disconnecting
 #define MQTTReserved    15 << 4 // Reserved
 
+// Návratový kód v CONNACK; nenulový znamená odmítnuté připojení
+#define MQTT_CONNACK_ACCEPTED 0
+#define MQTT_CONNACK_NONE 0xFF
+
 #define MQTTQOS0        (0 << 1)
 #define MQTTQOS1        (1 << 1)
 #define MQTTQOS2        (2 << 1)
@@ -55,39 +110,117 @@ struct MQTTConnectData
   uint16_t keepAlive;
 };
 
+#if MQTT_FEATURES & MQTT_FEATURE_COMPRESSION
+struct MQTTCompressTopic
+{
+  // Jméno tématu nebo filtr končící '#'; nullptr = téma z registru
+  const char* topic = nullptr;
+  MQTTTopicHandle handle = MQTT_TOPIC_NONE;
+  MQTTCompressStats stats;
+};
+#endif
+
 class MQTTClient
 {
   private:
     EspDrv* client;
     uint8_t* buffer;
-    uint16_t bufferSize = 256;
+    uint16_t bufferSize = MQTT_BUFFER_SIZE;
     uint16_t keepAlive = 30;
     unsigned long lastOutActivity;
-    unsigned long lastInActivity;
+    DeadlineList<4> timers;
+    unsigned long statusDeadline = 0;
+    static unsigned long lastInActivity;
     static bool pingOutstanding;
+    static unsigned long pingSent;
+    static unsigned long rttProbeStart;
+    static uint8_t rttProbePacket;
+    // Odpověď přišla ještě během Write (před SEND OK), vzorek se dopočítá po zápisu
+    static bool rttProbeWriting;
+    static unsigned long rttProbeAnswer;
+    static RttEstimator rtt;
+    uint16_t deadLinkCount = 0;
+    unsigned long firstPublishTime = 0;
     uint32_t nextMsgId;
     static void DataReceived(uint8_t* data, int length);
-    bool Login(MQTTConnectData mQTTConnectData);
+    uint8_t* connectPacket = nullptr;
+    uint16_t connectPacketLength = 0;
+    uint16_t connectPacketCapacity = 0;
+    bool ownsConnectPacket = true;
+    uint8_t features = MQTT_FEATURES;
     uint16_t WriteString(const char* string, uint8_t* buf, uint16_t pos);
     bool Write(uint8_t header, uint8_t* buf, uint16_t length);
     size_t BuildHeader(uint8_t header, uint8_t* buf, uint16_t length);
     static void (*callback)(char* topic, uint8_t* payload, uint16_t plength);
+    static MQTTTopicRegistry* topicRegistry;
+    static void (*handleCallback)(MQTTTopicHandle topic, uint8_t* payload, uint16_t plength);
+    bool SendPublish(uint16_t length, boolean retained);
+    // Začátek payloadu v bufferu po BeginPublish, 0 = nic rozepsaného
+    uint16_t publishStart = 0;
+    MQTTPayloadWriter StartPayload(MQTTPayloadFormat format, const char* topic, MQTTTopicHandle handle);
+    uint16_t WritePayload(uint16_t pos, const uint8_t* payload, unsigned int plength, const char* topic, MQTTTopicHandle handle);
+#if MQTT_FEATURES & MQTT_FEATURE_COMPRESSION
+    static MQTTCompressTopic compressTopics[MQTT_COMPRESS_TOPICS];
+    static uint8_t compressTopicCount;
+    static uint8_t* compressBuffer;
+    static uint16_t compressBufferSize;
+    // Téma rozepsané přes BeginPublish, pokud je komprimované
+    MQTTCompressTopic* publishCompress = nullptr;
+    static MQTTCompressTopic* FindCompressTopic(const char* topic, MQTTTopicHandle handle);
+    static bool TopicMatches(const char* filter, const char* topic, uint16_t length, bool flash);
+    static void CountEncoded(MQTTCompressStats& stats, uint16_t raw, uint16_t packed);
+    static bool Inflate(MQTTCompressTopic* compressed, uint8_t** payload, uint16_t* length);
+    // Příjem a odesílání volají kompresi jen přes ukazatele, které nastaví EnableCompression.
+    // Sketch, který kompresi nezapne, kodér ani tabulku témat nelinkuje.
+    static MQTTCompressTopic* (*findCompress)(const char* topic, MQTTTopicHandle handle);
+    static uint16_t (*encode)(const uint8_t* data, uint16_t length, uint8_t* out, uint16_t capacity);
+    static bool (*inflate)(MQTTCompressTopic* compressed, uint8_t** payload, uint16_t* length);
+    bool AddCompressTopic(const char* topic, MQTTTopicHandle handle);
+#endif
     void (*connected)();
     bool isConnected = false;
     static bool suback;
     static bool connack;
+    static uint8_t connackCode;
     static uint16_t* qosBufferPacketIds;
     static uint8_t qosBufferHead;
     static uint8_t qosBufferTail;
     static uint8_t qosBufferCount;
     static bool fullQoSBuffer;
     static uint8_t qosBufferLength;
+#if MQTT_FEATURES & MQTT_FEATURE_INBOUND_QUEUE
+    static uint8_t* inboundPool;
+    static uint16_t inboundSlotSize;
+    static uint8_t inboundSlotCount;
+    static uint8_t inboundHead;
+    static uint8_t inboundTail;
+    static uint8_t inboundCount;
+    static uint8_t inboundHighWater;
+    static uint16_t inboundDrops;
+    static bool QueueInbound(const char* topic, uint16_t topicLen, MQTTTopicHandle handle, const uint8_t* payload, uint16_t payloadLen);
+    // Nastaví EnableInboundQueue; bez jejího volání se kód fronty nelinkuje (--gc-sections)
+    static bool (*queueInbound)(const char* topic, uint16_t topicLen, MQTTTopicHandle handle, const uint8_t* payload, uint16_t payloadLen);
+#endif
 
     void sendPubAck(uint16_t packetId);
+    void SendPing(unsigned long currentMillis);
+    void StartRttProbe(uint8_t responsePacket);
+    void SentRttProbe();
+    unsigned long ProbeInterval();
+    void OutActivity(unsigned long now);
+    bool TimerActive(uint8_t timer);
+    void InitState(EspDrv *espDriver, void(*callback)(char* topic, uint8_t* payload, uint16_t plength));
+
+  protected:
+    MQTTClient(EspDrv *espDriver, void(*callback)(char* topic, uint8_t* payload, uint16_t plength),
+      uint8_t* buffer, uint16_t bufferSize, uint16_t* qosBuffer, uint8_t qosBufferLength, uint8_t* connectStorage, uint16_t connectStorageSize, uint8_t features);
     
   public:
     MQTTClient(EspDrv *espDriver, void(*callback)(char* topic, uint8_t* payload, uint16_t plength), uint8_t pQosBufferLength = 16);
     bool Connect(MQTTConnectData mQTTConnectData);
+    bool PrepareConnect(MQTTConnectData mQTTConnectData);
+    bool Login();
+    bool Resume();
     void Disconnect();
     void Subscribe(const char* topic);
     void Subscribe(const char* topic, uint8_t qos);
@@ -95,8 +228,74 @@ class MQTTClient
     bool Publish(const char* topic, const char* payload, boolean retained);
     bool Publish(const char* topic, const uint8_t* payload, unsigned int plength);
     bool Publish(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained);
+    // Témata z registru: zprávy na registrovaná témata jdou do handleCallback místo callbacku
+    void SetTopicRegistry(MQTTTopicRegistry* registry, void(*handleCallback)(MQTTTopicHandle topic, uint8_t* payload, uint16_t plength));
+    bool Publish(MQTTTopicHandle topic, const char* payload);
+    bool Publish(MQTTTopicHandle topic, const uint8_t* payload, unsigned int plength, boolean retained = false);
+    // Payload se zapisuje rovnou do TX bufferu za téma. Mezi BeginPublish a EndPublish se nesmí
+    // volat jiné metody klienta (Loop posílá PINGREQ ze stejného bufferu).
+    MQTTPayloadWriter BeginPublish(const char* topic, MQTTPayloadFormat format);
+    MQTTPayloadWriter BeginPublish(MQTTTopicHandle topic, MQTTPayloadFormat format);
+    bool EndPublish(MQTTPayloadWriter& payload, boolean retained = false);
     bool Loop();
     bool IsConnected();
+#if MQTT_FEATURES & MQTT_FEATURE_INBOUND_QUEUE
+    bool EnableInboundQueue(uint8_t slotCount, uint16_t slotSize);
+    void EnableInboundQueue(uint8_t* storage, uint16_t storageSize, uint16_t slotSize);
+    uint8_t Poll();
+    uint8_t GetInboundHighWater();
+    uint16_t GetInboundDrops();
+#endif
+#if MQTT_FEATURES & MQTT_FEATURE_COMPRESSION
+    // Payload na tématu začíná hlavičkou MQTTCompress; komprimuje se, jen když se zmenší.
+    // Téma se zadává stejně jako při publikování (jméno nebo handle), filtr může končit úrovní '#'.
+    // Jméno nebo filtr platí i pro témata z registru (Publish(handle), příjem přes handle).
+    bool EnableCompression(const char* topic);
+    bool EnableCompression(MQTTTopicHandle topic);
+    // Pracovní buffer: rozbalené příchozí zprávy a komprese payloadu z BeginPublish.
+    // Bez fronty příjmu platí rozbalený payload jen do návratu z callbacku.
+    void SetCompressBuffer(uint8_t* buffer, uint16_t size);
+    // nullptr, pokud téma nemá kompresi
+    const MQTTCompressStats* GetCompressStats(const char* topic);
+    const MQTTCompressStats* GetCompressStats(MQTTTopicHandle topic);
+#endif
+    const RttEstimator& GetRtt();
+    unsigned long GetProbeTimeout();
+    uint16_t GetDeadLinkCount();
+    // Kód z posledního CONNACK (1-5 = broker připojení odmítl), MQTT_CONNACK_NONE bez odpovědi
+    uint8_t GetConnectReturnCode();
+    // Doba (ms) do další časované akce klienta nebo ovladače; mezi tím stačí čekat na data z UARTu
+    unsigned long NextDeadline();
+    unsigned long GetFirstPublishTime();
+};
+
+/*
+  MQTTClient bez haldy. Veškerá paměť je součástí objektu, takže se velikost
+  ukáže při linkování (.bss/.data). Features musí být podmnožinou MQTT_FEATURES,
+  funkce mimo MQTT_FEATURES nejsou v knihovně vůbec přeložené. Fronta příjmu a komprese
+  se i bez MQTT_FEATURES linkují, jen když je sketch zapne (EnableInboundQueue, EnableCompression).
+  ConnectSize je místo pro uložený CONNECT paket (PrepareConnect).
+*/
+template<uint16_t TxSize, uint8_t QosDepth = 16, uint8_t Features = MQTT_FEATURES, uint16_t ConnectSize = 64>
+class MQTTClientStatic : public MQTTClient
+{
+  static_assert(TxSize > MQTT_MAX_HEADER_SIZE + 2, "TxSize too small");
+  static_assert((Features & ~MQTT_FEATURES) == 0, "Feature not compiled into the library, see MQTT_FEATURES");
+  static_assert(QosDepth == 0 || (Features & MQTT_FEATURE_QOS1), "QosDepth requires MQTT_FEATURE_QOS1");
+  static_assert(QosDepth > 0 || !(Features & MQTT_FEATURE_QOS1), "MQTT_FEATURE_QOS1 requires QosDepth > 0");
+
+  private:
+    uint8_t txBuffer[TxSize];
+    uint16_t qosBuffer[QosDepth > 0 ? QosDepth : 1];
+    uint8_t connectStorage[ConnectSize];
+
+  public:
+    static const uint16_t StorageSize = TxSize + 2 * (QosDepth > 0 ? QosDepth : 1) + ConnectSize;
+
+    MQTTClientStatic(EspDrv *espDriver, void(*callback)(char* topic, uint8_t* payload, uint16_t plength))
+      : MQTTClient(espDriver, callback, txBuffer, TxSize, qosBuffer, QosDepth, connectStorage, ConnectSize, Features)
+    {
+    }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,190 @@
+#include "MQTTCompress.h"
+
+#define LZSS_LITERAL_BITS 9
+
+// Bity se zapisují od nejvyššího, poslední byte je doplněný nulami
+struct LzssWriter
+{
+  uint8_t* buffer;
+  uint16_t capacity;
+  uint16_t pos;
+  uint8_t bit;
+
+  bool Put(uint16_t value, uint8_t count)
+  {
+    while(count-- > 0)
+    {
+      if(bit == 0)
+      {
+        if(pos >= capacity)
+        {
+          return false;
+        }
+        buffer[pos] = 0;
+      }
+      if((value >> count) & 1)
+      {
+        buffer[pos] |= 0x80 >> bit;
+      }
+      if(++bit == 8)
+      {
+        bit = 0;
+        pos++;
+      }
+    }
+    return true;
+  }
+
+  uint16_t GetLength()
+  {
+    return pos + (bit > 0 ? 1 : 0);
+  }
+};
+
+struct LzssReader
+{
+  const uint8_t* data;
+  uint32_t bits;
+  uint32_t pos;
+
+  uint32_t Remaining()
+  {
+    return bits - pos;
+  }
+
+  uint16_t Get(uint8_t count)
+  {
+    uint16_t value = 0;
+    while(count-- > 0)
+    {
+      value = (value << 1) | ((data[pos >> 3] >> (7 - (pos & 7))) & 1);
+      pos++;
+    }
+    return value;
+  }
+};
+
+uint16_t MQTTCompress::Encode(const uint8_t* data, uint16_t length, uint8_t* out, uint16_t capacity)
+{
+  // Výsledek musí být kratší než původní data, jinak se posílají beze změny
+  if(length < 3)
+  {
+    return 0;
+  }
+  const uint16_t window = 1 << MQTT_COMPRESS_WINDOW_BITS;
+  const uint8_t minMatch = MQTT_COMPRESS_MIN_MATCH(MQTT_COMPRESS_WINDOW_BITS, MQTT_COMPRESS_LENGTH_BITS);
+  const uint16_t maxMatch = minMatch + (1 << MQTT_COMPRESS_LENGTH_BITS) - 1;
+  LzssWriter bits = { out, min(capacity, (uint16_t)(length - 1)), 1, 0 };
+  if(bits.capacity < 2)
+  {
+    return 0;
+  }
+  out[0] = (MQTT_COMPRESS_WINDOW_BITS << 4) | MQTT_COMPRESS_LENGTH_BITS;
+  uint16_t i = 0;
+  while(i < length)
+  {
+    uint16_t longest = min(maxMatch, (uint16_t)(length - i));
+    uint16_t bestLength = 0;
+    uint16_t bestDistance = 0;
+    uint16_t start = i > window ? i - window : 0;
+    // Od nejbližšího; kandidát se porovná celý, jen když prodlužuje dosavadní nejlepší shodu
+    for(uint16_t j = i; j-- > start && bestLength < longest;)
+    {
+      if(data[j + bestLength] != data[i + bestLength])
+      {
+        continue;
+      }
+      uint16_t n = 0;
+      while(n < longest && data[j + n] == data[i + n])
+      {
+        n++;
+      }
+      if(n > bestLength)
+      {
+        bestLength = n;
+        bestDistance = i - j;
+      }
+    }
+    bool written;
+    if(bestLength >= minMatch)
+    {
+      written = bits.Put(0, 1) && bits.Put(bestDistance - 1, MQTT_COMPRESS_WINDOW_BITS)
+        && bits.Put(bestLength - minMatch, MQTT_COMPRESS_LENGTH_BITS);
+      i += bestLength;
+    }
+    else
+    {
+      written = bits.Put(0x100 | data[i], LZSS_LITERAL_BITS);
+      i++;
+    }
+    if(!written)
+    {
+      return 0;
+    }
+  }
+  return bits.GetLength();
+}
+
+bool MQTTCompress::Decode(const uint8_t* data, uint16_t length, uint8_t* out, uint16_t capacity, uint16_t* outLength)
+{
+  *outLength = 0;
+  if(length == 0)
+  {
+    return false;
+  }
+  uint8_t header = data[0];
+  if(header == MQTT_COMPRESS_NONE)
+  {
+    if(length - 1 > capacity)
+    {
+      return false;
+    }
+    memcpy(out, data + 1, length - 1);
+    *outLength = length - 1;
+    return true;
+  }
+  // Parametry jsou v hlavičce, přijmou se i jiné, než s jakými byla knihovna přeložena
+  uint8_t windowBits = header >> 4;
+  uint8_t lengthBits = header & 0x0F;
+  if(windowBits < 4 || lengthBits == 0 || windowBits + lengthBits < 7)
+  {
+    return false;
+  }
+  uint8_t minMatch = MQTT_COMPRESS_MIN_MATCH(windowBits, lengthBits);
+  LzssReader bits = { data + 1, (uint32_t)(length - 1) * 8, 0 };
+  uint16_t written = 0;
+  // Doplnění posledního bytu (nejvýš 7 nulových bitů) je kratší než literál i odkaz
+  while(bits.Remaining() > 0)
+  {
+    if(bits.Get(1))
+    {
+      if(bits.Remaining() < LZSS_LITERAL_BITS - 1)
+      {
+        return false;
+      }
+      if(written == capacity)
+      {
+        return false;
+      }
+      out[written++] = bits.Get(8);
+      continue;
+    }
+    if(bits.Remaining() < (uint32_t)windowBits + lengthBits)
+    {
+      break;
+    }
+    uint16_t distance = bits.Get(windowBits) + 1;
+    uint16_t count = bits.Get(lengthBits) + minMatch;
+    if(distance > written || count > capacity - written)
+    {
+      return false;
+    }
+    // Shoda se může překrývat se zapisovaným místem (opakování), kopíruje se po bytech
+    for(; count > 0; count--, written++)
+    {
+      out[written] = out[written - distance];
+    }
+  }
+  *outLength = written;
+  return true;
+}
@@ -0,0 +1,54 @@
+#ifndef __MQTTCOMPRESS_H
+#define __MQTTCOMPRESS_H
+
+#include <Arduino.h>
+
+// První byte payloadu na komprimovaném tématu: horní 4 bity = bity vzdálenosti (okno 2^n B),
+// dolní 4 bity = bity délky shody. 0 = payload následuje beze změny.
+#define MQTT_COMPRESS_NONE 0x00
+
+// Okno 256 B a shody do 17 B: zpětný odkaz má 13 bitů, literál 9
+#ifndef MQTT_COMPRESS_WINDOW_BITS
+#define MQTT_COMPRESS_WINDOW_BITS 8
+#endif
+#ifndef MQTT_COMPRESS_LENGTH_BITS
+#define MQTT_COMPRESS_LENGTH_BITS 4
+#endif
+
+// Nejkratší shoda, kterou se vyplatí kódovat odkazem (odkaz je kratší než tolik literálů)
+#define MQTT_COMPRESS_MIN_MATCH(windowBits, lengthBits) ((1 + (windowBits) + (lengthBits)) / 9 + 1)
+
+/*
+  LZSS ve stylu heatshrink: proud bitů, 1 + 8 bitů je literál, 0 + vzdálenost + délka je odkaz
+  do už zpracovaných dat. Celý payload je v paměti, takže oknem jsou přímo předchozí byty
+  vstupu (při kompresi) a výstupu (při dekompresi), žádný buffer ani halda navíc.
+*/
+class MQTTCompress
+{
+  static_assert(MQTT_COMPRESS_WINDOW_BITS >= 4 && MQTT_COMPRESS_WINDOW_BITS <= 15, "Window bits must fit the header nibble");
+  static_assert(MQTT_COMPRESS_LENGTH_BITS >= 1 && MQTT_COMPRESS_LENGTH_BITS <= 15, "Length bits must fit the header nibble");
+  // Odkaz musí být delší než zarovnání na konci (nejvýš 7 bitů)
+  static_assert(MQTT_COMPRESS_WINDOW_BITS + MQTT_COMPRESS_LENGTH_BITS >= 7, "Back-reference shorter than padding");
+
+  public:
+    // Zapíše hlavičku a komprimovaná data do out; 0 když výsledek není kratší než data nebo se nevejde
+    static uint16_t Encode(const uint8_t* data, uint16_t length, uint8_t* out, uint16_t capacity);
+    // Rozbalí payload s hlavičkou (i MQTT_COMPRESS_NONE); false při poškozených datech nebo malém out
+    static bool Decode(const uint8_t* data, uint16_t length, uint8_t* out, uint16_t capacity, uint16_t* outLength);
+};
+
+// Počítadla komprese jednoho tématu. Poměr je wireBytes / rawBytes, časy jsou součty micros().
+struct MQTTCompressStats
+{
+  uint32_t rawBytes = 0;
+  uint32_t wireBytes = 0;
+  uint32_t encodeMicros = 0;
+  uint32_t decodeMicros = 0;
+  uint16_t encoded = 0;
+  // Odesláno bez komprese, protože se nezmenšilo
+  uint16_t stored = 0;
+  uint16_t decoded = 0;
+  uint16_t decodeErrors = 0;
+};
+
+#endif
@@ -0,0 +1,1041 @@
+#include "MQTTPayload.h"
+
+// CBOR hlavní typy a jednobajtové hodnoty
+#define CBOR_UINT 0
+#define CBOR_NEGINT 1
+#define CBOR_BYTES 2
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_TAG 6
+#define CBOR_SIMPLE 7
+#define CBOR_INDEFINITE 31
+#define CBOR_FALSE 0xF4
+#define CBOR_TRUE 0xF5
+#define CBOR_NULL 0xF6
+#define CBOR_UNDEFINED 0xF7
+#define CBOR_HALF 0xF9
+#define CBOR_SINGLE 0xFA
+#define CBOR_DOUBLE 0xFB
+#define CBOR_BREAK 0xFF
+// Decimal fraction [exponent, mantissa]
+#define CBOR_TAG_DECIMAL 4
+#define CBOR_PAIR 0x82
+
+static uint32_t Pow10(uint8_t n)
+{
+  uint32_t result = 1;
+  while(n-- > 0)
+  {
+    result *= 10;
+  }
+  return result;
+}
+
+static uint32_t Magnitude(int32_t value)
+{
+  return value < 0 ? (uint32_t)0 - (uint32_t)value : (uint32_t)value;
+}
+
+static float BitsToFloat(uint32_t bits)
+{
+  float value;
+  memcpy(&value, &bits, 4);
+  return value;
+}
+
+MQTTPayloadWriter::MQTTPayloadWriter(MQTTPayloadFormat format)
+{
+  this->buffer = nullptr;
+  this->capacity = 0;
+  this->format = format;
+  this->sizing = true;
+}
+
+MQTTPayloadWriter::MQTTPayloadWriter(uint8_t* buffer, uint16_t capacity, MQTTPayloadFormat format)
+{
+  this->buffer = buffer;
+  this->capacity = buffer != nullptr ? capacity : 0;
+  this->format = format;
+  this->sizing = false;
+}
+
+void MQTTPayloadWriter::Put(uint8_t b)
+{
+  if(length < capacity)
+  {
+    buffer[length] = b;
+  }
+  else if(!sizing)
+  {
+    error = true;
+  }
+  if(length == 0xFFFF)
+  {
+    error = true;
+    return;
+  }
+  length++;
+}
+
+void MQTTPayloadWriter::Put(const uint8_t* data, uint16_t dataLength)
+{
+  uint16_t fit = length < capacity ? min(dataLength, (uint16_t)(capacity - length)) : 0;
+  memcpy(buffer + length, data, fit);
+  if(fit < dataLength && !sizing)
+  {
+    error = true;
+  }
+  if(dataLength > 0xFFFF - length)
+  {
+    error = true;
+    length = 0xFFFF;
+    return;
+  }
+  length += dataLength;
+}
+
+void MQTTPayloadWriter::PutHead(uint8_t major, uint32_t value)
+{
+  major <<= 5;
+  if(value < 24)
+  {
+    Put(major | value);
+  }
+  else if(value <= 0xFF)
+  {
+    Put(major | 24);
+    Put(value);
+  }
+  else if(value <= 0xFFFF)
+  {
+    Put(major | 25);
+    Put(value >> 8);
+    Put(value);
+  }
+  else
+  {
+    Put(major | 26);
+    Put(value >> 24);
+    Put(value >> 16);
+    Put(value >> 8);
+    Put(value);
+  }
+}
+
+void MQTTPayloadWriter::PutDecimal(uint32_t value)
+{
+  uint8_t digits[10];
+  uint8_t count = 0;
+  do
+  {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  }
+  while(value > 0);
+  while(count > 0)
+  {
+    Put(digits[--count]);
+  }
+}
+
+void MQTTPayloadWriter::PutInt(int32_t value)
+{
+  if(format == MQTT_PAYLOAD_CBOR)
+  {
+    // Záporné číslo n se kóduje jako -1 - n
+    PutHead(value < 0 ? CBOR_NEGINT : CBOR_UINT, value < 0 ? Magnitude(value) - 1 : (uint32_t)value);
+    return;
+  }
+  if(value < 0)
+  {
+    Put('-');
+  }
+  PutDecimal(Magnitude(value));
+}
+
+void MQTTPayloadWriter::PutFixed(int32_t value, uint8_t decimals)
+{
+  if(format == MQTT_PAYLOAD_CBOR)
+  {
+    Put((CBOR_TAG << 5) | CBOR_TAG_DECIMAL);
+    Put(CBOR_PAIR);
+    PutInt(-(int32_t)decimals);
+    PutInt(value);
+    return;
+  }
+  uint32_t magnitude = Magnitude(value);
+  uint32_t scale = Pow10(decimals);
+  if(value < 0)
+  {
+    Put('-');
+  }
+  PutDecimal(magnitude / scale);
+  Put('.');
+  uint32_t fraction = magnitude % scale;
+  while(decimals-- > 0)
+  {
+    scale /= 10;
+    Put('0' + (fraction / scale) % 10);
+  }
+}
+
+void MQTTPayloadWriter::BeginValue(bool key)
+{
+  bool inMap = depth > 0 && (mapLevels & (1 << (depth - 1)));
+  // V mapě se střídá klíč a hodnota, mimo mapu klíče nejsou
+  if(key != (inMap && !afterKey) || (depth == 0 && length > 0))
+  {
+    error = true;
+  }
+  if(afterKey)
+  {
+    afterKey = false;
+    return;
+  }
+  if(depth > 0)
+  {
+    uint8_t bit = 1 << (depth - 1);
+    if(format == MQTT_PAYLOAD_JSON && (nonEmptyLevels & bit))
+    {
+      Put(',');
+    }
+    nonEmptyLevels |= bit;
+  }
+  afterKey = key;
+}
+
+void MQTTPayloadWriter::Begin(bool map, uint16_t count)
+{
+  BeginValue(false);
+  if(depth == MQTT_PAYLOAD_MAX_DEPTH)
+  {
+    error = true;
+    return;
+  }
+  uint8_t bit = 1 << depth;
+  if(format == MQTT_PAYLOAD_CBOR)
+  {
+    uint8_t major = map ? CBOR_MAP : CBOR_ARRAY;
+    if(count == MQTT_PAYLOAD_INDEFINITE)
+    {
+      Put((major << 5) | CBOR_INDEFINITE);
+      indefiniteLevels |= bit;
+    }
+    else
+    {
+      PutHead(major, count);
+      indefiniteLevels &= ~bit;
+    }
+  }
+  else
+  {
+    Put(map ? '{' : '[');
+  }
+  mapLevels = map ? mapLevels | bit : mapLevels & ~bit;
+  nonEmptyLevels &= ~bit;
+  depth++;
+}
+
+void MQTTPayloadWriter::BeginMap(uint16_t count)
+{
+  Begin(true, count);
+}
+
+void MQTTPayloadWriter::BeginArray(uint16_t count)
+{
+  Begin(false, count);
+}
+
+void MQTTPayloadWriter::End()
+{
+  if(depth == 0 || afterKey)
+  {
+    error = true;
+    return;
+  }
+  depth--;
+  uint8_t bit = 1 << depth;
+  if(format == MQTT_PAYLOAD_CBOR)
+  {
+    if(indefiniteLevels & bit)
+    {
+      Put(CBOR_BREAK);
+    }
+  }
+  else
+  {
+    Put((mapLevels & bit) ? '}' : ']');
+  }
+}
+
+void MQTTPayloadWriter::WriteText(const char* value, uint16_t textLength)
+{
+  if(format == MQTT_PAYLOAD_CBOR)
+  {
+    PutHead(CBOR_TEXT, textLength);
+    Put((const uint8_t*)value, textLength);
+    return;
+  }
+  Put('"');
+  for(uint16_t i = 0; i < textLength; i++)
+  {
+    uint8_t c = value[i];
+    if(c == '"' || c == '\\')
+    {
+      Put('\\');
+      Put(c);
+    }
+    else if(c < 0x20)
+    {
+      Put('\\');
+      Put('u');
+      Put('0');
+      Put('0');
+      Put('0' + (c >> 4));
+      Put("0123456789abcdef"[c & 0x0F]);
+    }
+    else
+    {
+      Put(c);
+    }
+  }
+  Put('"');
+}
+
+void MQTTPayloadWriter::Key(const char* key)
+{
+  BeginValue(true);
+  WriteText(key, strlen(key));
+  if(format == MQTT_PAYLOAD_JSON)
+  {
+    Put(':');
+  }
+}
+
+void MQTTPayloadWriter::Int(int32_t value)
+{
+  BeginValue(false);
+  PutInt(value);
+}
+
+void MQTTPayloadWriter::Fixed(int32_t value, uint8_t decimals)
+{
+  BeginValue(false);
+  if(decimals > MQTT_PAYLOAD_MAX_DECIMALS)
+  {
+    error = true;
+    return;
+  }
+  if(decimals == 0)
+  {
+    PutInt(value);
+  }
+  else
+  {
+    PutFixed(value, decimals);
+  }
+}
+
+void MQTTPayloadWriter::Float(float value, uint8_t decimals)
+{
+  BeginValue(false);
+  if(format == MQTT_PAYLOAD_CBOR)
+  {
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int16_t exponent = (int16_t)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    // Half float stačí, když se hodnota vejde bez ztráty (nula, malá celá čísla, 21.5, ...)
+    if((bits & 0x7FFFFFFF) == 0)
+    {
+      Put(CBOR_HALF);
+      Put(sign >> 8);
+      Put(0);
+    }
+    else if(exponent >= 1 && exponent <= 30 && (mantissa & 0x1FFF) == 0)
+    {
+      uint16_t half = sign | (exponent << 10) | (mantissa >> 13);
+      Put(CBOR_HALF);
+      Put(half >> 8);
+      Put(half);
+    }
+    else
+    {
+      Put(CBOR_SINGLE);
+      Put(bits >> 24);
+      Put(bits >> 16);
+      Put(bits >> 8);
+      Put(bits);
+    }
+    return;
+  }
+  if(isnan(value) || isinf(value))
+  {
+    Put((const uint8_t*)"null", 4);
+    return;
+  }
+  decimals = min(decimals, (uint8_t)MQTT_PAYLOAD_MAX_DECIMALS);
+  float scaled = value * Pow10(decimals);
+  // Velká čísla ztratí desetinná místa, aby se vešla do int32
+  while(decimals > 0 && fabs(scaled) >= 2147483520.0f)
+  {
+    decimals--;
+    scaled = value * Pow10(decimals);
+  }
+  if(fabs(scaled) >= 2147483520.0f)
+  {
+    Put((const uint8_t*)"null", 4);
+    return;
+  }
+  int32_t rounded = (int32_t)(scaled + (scaled < 0 ? -0.5f : 0.5f));
+  if(decimals == 0)
+  {
+    PutInt(rounded);
+  }
+  else
+  {
+    PutFixed(rounded, decimals);
+  }
+}
+
+void MQTTPayloadWriter::Text(const char* value)
+{
+  if(value == nullptr)
+  {
+    Null();
+    return;
+  }
+  Text(value, strlen(value));
+}
+
+void MQTTPayloadWriter::Text(const char* value, uint16_t textLength)
+{
+  BeginValue(false);
+  WriteText(value, textLength);
+}
+
+void MQTTPayloadWriter::Bool(bool value)
+{
+  BeginValue(false);
+  if(format == MQTT_PAYLOAD_CBOR)
+  {
+    Put(value ? CBOR_TRUE : CBOR_FALSE);
+  }
+  else if(value)
+  {
+    Put((const uint8_t*)"true", 4);
+  }
+  else
+  {
+    Put((const uint8_t*)"false", 5);
+  }
+}
+
+void MQTTPayloadWriter::Null()
+{
+  BeginValue(false);
+  if(format == MQTT_PAYLOAD_CBOR)
+  {
+    Put(CBOR_NULL);
+  }
+  else
+  {
+    Put((const uint8_t*)"null", 4);
+  }
+}
+
+uint16_t MQTTPayloadWriter::GetLength()
+{
+  return length;
+}
+
+const uint8_t* MQTTPayloadWriter::GetBuffer()
+{
+  return buffer;
+}
+
+MQTTPayloadFormat MQTTPayloadWriter::GetFormat()
+{
+  return format;
+}
+
+bool MQTTPayloadWriter::IsValid()
+{
+  return !error && depth == 0 && !afterKey;
+}
+
+MQTTPayloadReader::MQTTPayloadReader(const uint8_t* data, uint16_t length, MQTTPayloadFormat format)
+{
+  this->data = data;
+  this->length = data != nullptr ? length : 0;
+  this->format = format;
+}
+
+MQTTPayloadItem MQTTPayloadReader::Fail()
+{
+  error = true;
+  type = MQTT_ITEM_NONE;
+  return MQTT_ITEM_NONE;
+}
+
+bool MQTTPayloadReader::Push(uint16_t items)
+{
+  if(depth == MQTT_PAYLOAD_MAX_DEPTH)
+  {
+    return false;
+  }
+  remaining[depth++] = items;
+  return true;
+}
+
+MQTTPayloadItem MQTTPayloadReader::Next()
+{
+  if(error)
+  {
+    return MQTT_ITEM_NONE;
+  }
+  decimals = 0;
+  type = format == MQTT_PAYLOAD_CBOR ? NextCbor() : NextJson();
+  return type;
+}
+
+bool MQTTPayloadReader::ReadHead(uint8_t* major, uint32_t* value, bool* indefinite)
+{
+  if(pos >= length)
+  {
+    return false;
+  }
+  uint8_t initial = data[pos++];
+  uint8_t info = initial & 0x1F;
+  *major = initial >> 5;
+  *indefinite = false;
+  *value = 0;
+  if(info < 24)
+  {
+    *value = info;
+    return true;
+  }
+  if(info == CBOR_INDEFINITE)
+  {
+    *indefinite = true;
+    return *major >= CBOR_BYTES && *major <= CBOR_MAP;
+  }
+  // 8bytové hodnoty se nepodporují
+  if(info > 26)
+  {
+    return false;
+  }
+  uint8_t size = 1 << (info - 24);
+  if(size > length - pos)
+  {
+    return false;
+  }
+  while(size-- > 0)
+  {
+    *value = (*value << 8) | data[pos++];
+  }
+  return true;
+}
+
+bool MQTTPayloadReader::ReadCborInt(int32_t* value)
+{
+  uint8_t major;
+  uint32_t raw;
+  bool indefinite;
+  if(!ReadHead(&major, &raw, &indefinite) || indefinite || (major != CBOR_UINT && major != CBOR_NEGINT) || raw > 0x7FFFFFFF)
+  {
+    return false;
+  }
+  *value = major == CBOR_UINT ? (int32_t)raw : -1 - (int32_t)raw;
+  return true;
+}
+
+MQTTPayloadItem MQTTPayloadReader::NextCbor()
+{
+  if(depth > 0 && remaining[depth - 1] == 0)
+  {
+    depth--;
+    return MQTT_ITEM_END;
+  }
+  if(pos >= length)
+  {
+    return depth == 0 ? MQTT_ITEM_NONE : Fail();
+  }
+  uint8_t initial = data[pos];
+  if(initial == CBOR_BREAK)
+  {
+    if(depth == 0 || remaining[depth - 1] != MQTT_PAYLOAD_INDEFINITE)
+    {
+      return Fail();
+    }
+    pos++;
+    depth--;
+    return MQTT_ITEM_END;
+  }
+  if(depth > 0 && remaining[depth - 1] != MQTT_PAYLOAD_INDEFINITE)
+  {
+    remaining[depth - 1]--;
+  }
+  if((initial >> 5) == CBOR_SIMPLE)
+  {
+    pos++;
+    switch(initial)
+    {
+      case CBOR_FALSE:
+      case CBOR_TRUE:
+        mantissa = initial == CBOR_TRUE;
+        return MQTT_ITEM_BOOL;
+      case CBOR_NULL:
+      case CBOR_UNDEFINED:
+        return MQTT_ITEM_NULL;
+      case CBOR_HALF:
+      {
+        if(length - pos < 2)
+        {
+          return Fail();
+        }
+        uint16_t half = (data[pos] << 8) | data[pos + 1];
+        pos += 2;
+        uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+        uint8_t exponent = (half >> 10) & 0x1F;
+        uint32_t fraction = half & 0x3FF;
+        if(exponent == 0)
+        {
+          // Subnormální: fraction * 2^-24
+          floatValue = fraction * (1.0f / 16777216.0f);
+          if(sign)
+          {
+            floatValue = -floatValue;
+          }
+        }
+        else
+        {
+          uint32_t biased = exponent == 31 ? 0xFF : exponent - 15 + 127;
+          floatValue = BitsToFloat(sign | (biased << 23) | (fraction << 13));
+        }
+        return MQTT_ITEM_FLOAT;
+      }
+      case CBOR_SINGLE:
+      case CBOR_DOUBLE:
+      {
+        uint8_t size = initial == CBOR_SINGLE ? 4 : 8;
+        if(length - pos < size)
+        {
+          return Fail();
+        }
+        uint32_t high = ((uint32_t)data[pos] << 24) | ((uint32_t)data[pos + 1] << 16) | ((uint32_t)data[pos + 2] << 8) | data[pos + 3];
+        uint32_t low = size == 8 ? ((uint32_t)data[pos + 4] << 24) | ((uint32_t)data[pos + 5] << 16) | ((uint32_t)data[pos + 6] << 8) | data[pos + 7] : 0;
+        pos += size;
+        if(size == 4)
+        {
+          floatValue = BitsToFloat(high);
+          return MQTT_ITEM_FLOAT;
+        }
+        // Double se zkrátí na float (na AVR je double stejně 32bitový)
+        uint32_t sign = high & 0x80000000;
+        int16_t exponent = (high >> 20) & 0x7FF;
+        uint32_t fraction = ((high & 0xFFFFF) << 3) | (low >> 29);
+        uint32_t bits = sign;
+        if(exponent == 0x7FF)
+        {
+          bits |= 0x7F800000 | (fraction != 0 ? 0x400000 : 0);
+        }
+        else if(exponent != 0)
+        {
+          exponent = exponent - 1023 + 127;
+          if(exponent >= 0xFF)
+          {
+            bits |= 0x7F800000;
+          }
+          else if(exponent > 0)
+          {
+            bits |= ((uint32_t)exponent << 23) | fraction;
+          }
+        }
+        floatValue = BitsToFloat(bits);
+        return MQTT_ITEM_FLOAT;
+      }
+      default:
+        return Fail();
+    }
+  }
+  uint8_t major;
+  uint32_t value;
+  bool indefinite;
+  if(!ReadHead(&major, &value, &indefinite))
+  {
+    return Fail();
+  }
+  switch(major)
+  {
+    case CBOR_UINT:
+    case CBOR_NEGINT:
+      if(value > 0x7FFFFFFF)
+      {
+        return Fail();
+      }
+      mantissa = major == CBOR_UINT ? (int32_t)value : -1 - (int32_t)value;
+      return MQTT_ITEM_INT;
+    case CBOR_BYTES:
+    case CBOR_TEXT:
+      // Text po kouscích (indefinite) nejde číst bez kopírování
+      if(indefinite || value > (uint32_t)(length - pos))
+      {
+        return Fail();
+      }
+      text = (const char*)data + pos;
+      count = value;
+      pos += value;
+      return MQTT_ITEM_TEXT;
+    case CBOR_ARRAY:
+    case CBOR_MAP:
+    {
+      if(!indefinite && value > (major == CBOR_MAP ? 0x7FFF : 0xFFFE))
+      {
+        return Fail();
+      }
+      count = indefinite ? MQTT_PAYLOAD_INDEFINITE : value;
+      uint16_t items = indefinite || major == CBOR_ARRAY ? count : count * 2;
+      if(!Push(items))
+      {
+        return Fail();
+      }
+      return major == CBOR_MAP ? MQTT_ITEM_MAP : MQTT_ITEM_ARRAY;
+    }
+    case CBOR_TAG:
+      if(value == CBOR_TAG_DECIMAL)
+      {
+        int32_t exponent;
+        if(pos >= length || data[pos++] != CBOR_PAIR || !ReadCborInt(&exponent) || !ReadCborInt(&mantissa))
+        {
+          return Fail();
+        }
+        if(exponent > 0 || exponent < -MQTT_PAYLOAD_MAX_DECIMALS)
+        {
+          return Fail();
+        }
+        decimals = -exponent;
+        return MQTT_ITEM_FIXED;
+      }
+      // Ostatní tagy se přeskočí, vrací se označená hodnota
+      if(depth > 0 && remaining[depth - 1] != MQTT_PAYLOAD_INDEFINITE)
+      {
+        remaining[depth - 1]++;
+      }
+      return NextCbor();
+  }
+  return Fail();
+}
+
+bool MQTTPayloadReader::ReadJsonLiteral(const char* literal)
+{
+  uint16_t literalLength = strlen(literal);
+  if(length - pos < literalLength || memcmp(data + pos, literal, literalLength) != 0)
+  {
+    return false;
+  }
+  pos += literalLength;
+  return true;
+}
+
+MQTTPayloadItem MQTTPayloadReader::ReadJsonNumber()
+{
+  bool negative = data[pos] == '-';
+  if(negative)
+  {
+    pos++;
+  }
+  uint32_t magnitude = 0;
+  float value = 0;
+  float fractionScale = 1;
+  bool exact = true;
+  bool digits = false;
+  bool fraction = false;
+  while(pos < length)
+  {
+    uint8_t c = data[pos];
+    if(c == '.' && !fraction)
+    {
+      fraction = true;
+      pos++;
+      continue;
+    }
+    if(c < '0' || c > '9')
+    {
+      break;
+    }
+    uint8_t digit = c - '0';
+    digits = true;
+    if(fraction)
+    {
+      fractionScale *= 0.1f;
+      value += digit * fractionScale;
+    }
+    else
+    {
+      value = value * 10 + digit;
+    }
+    // Přesná hodnota, dokud se vejde do int32 a MQTT_PAYLOAD_MAX_DECIMALS
+    if(exact && magnitude <= (0x7FFFFFFFUL - digit) / 10 && (!fraction || decimals < MQTT_PAYLOAD_MAX_DECIMALS))
+    {
+      magnitude = magnitude * 10 + digit;
+      decimals += fraction;
+    }
+    else
+    {
+      exact = false;
+    }
+    pos++;
+  }
+  if(!digits)
+  {
+    return Fail();
+  }
+  if(pos < length && (data[pos] == 'e' || data[pos] == 'E'))
+  {
+    pos++;
+    bool negativeExponent = pos < length && data[pos] == '-';
+    if(pos < length && (data[pos] == '-' || data[pos] == '+'))
+    {
+      pos++;
+    }
+    uint8_t exponent = 0;
+    bool exponentDigits = false;
+    while(pos < length && data[pos] >= '0' && data[pos] <= '9')
+    {
+      exponent = min(exponent * 10 + (data[pos] - '0'), 99);
+      exponentDigits = true;
+      pos++;
+    }
+    if(!exponentDigits)
+    {
+      return Fail();
+    }
+    while(exponent-- > 0)
+    {
+      value = negativeExponent ? value * 0.1f : value * 10;
+    }
+    exact = false;
+  }
+  if(!exact)
+  {
+    floatValue = negative ? -value : value;
+    return MQTT_ITEM_FLOAT;
+  }
+  mantissa = negative ? -(int32_t)magnitude : (int32_t)magnitude;
+  return decimals > 0 ? MQTT_ITEM_FIXED : MQTT_ITEM_INT;
+}
+
+MQTTPayloadItem MQTTPayloadReader::NextJson()
+{
+  // Čárky a dvojtečky nenesou informaci, přeskakují se jako mezery
+  while(pos < length && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r' || data[pos] == '\n' || data[pos] == ',' || data[pos] == ':'))
+  {
+    pos++;
+  }
+  if(pos >= length)
+  {
+    return depth == 0 ? MQTT_ITEM_NONE : Fail();
+  }
+  uint8_t c = data[pos];
+  switch(c)
+  {
+    case '{':
+    case '[':
+      pos++;
+      count = MQTT_PAYLOAD_INDEFINITE;
+      // remaining v JSON jen pamatuje druh závorky
+      if(!Push(c == '{'))
+      {
+        return Fail();
+      }
+      return c == '{' ? MQTT_ITEM_MAP : MQTT_ITEM_ARRAY;
+    case '}':
+    case ']':
+      if(depth == 0 || remaining[depth - 1] != (c == '}'))
+      {
+        return Fail();
+      }
+      pos++;
+      depth--;
+      return MQTT_ITEM_END;
+    case '"':
+    {
+      uint16_t start = ++pos;
+      while(pos < length && data[pos] != '"')
+      {
+        pos += data[pos] == '\\' ? 2 : 1;
+      }
+      if(pos >= length)
+      {
+        return Fail();
+      }
+      text = (const char*)data + start;
+      count = pos - start;
+      pos++;
+      return MQTT_ITEM_TEXT;
+    }
+    case 't':
+    case 'f':
+      if(!ReadJsonLiteral(c == 't' ? "true" : "false"))
+      {
+        return Fail();
+      }
+      mantissa = c == 't';
+      return MQTT_ITEM_BOOL;
+    case 'n':
+      return ReadJsonLiteral("null") ? MQTT_ITEM_NULL : Fail();
+  }
+  if(c == '-' || (c >= '0' && c <= '9'))
+  {
+    return ReadJsonNumber();
+  }
+  return Fail();
+}
+
+MQTTPayloadItem MQTTPayloadReader::GetType()
+{
+  return type;
+}
+
+bool MQTTPayloadReader::Skip()
+{
+  if(type != MQTT_ITEM_MAP && type != MQTT_ITEM_ARRAY)
+  {
+    return !error;
+  }
+  uint8_t target = depth - 1;
+  while(depth > target)
+  {
+    if(Next() == MQTT_ITEM_NONE)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool MQTTPayloadReader::Find(const char* key)
+{
+  while(true)
+  {
+    MQTTPayloadItem item = Next();
+    if(item == MQTT_ITEM_NONE || item == MQTT_ITEM_END)
+    {
+      return false;
+    }
+    bool match = item == MQTT_ITEM_TEXT && TextEquals(key);
+    // Klíč jiného typu než text (jen CBOR) se přeskočí i s obsahem
+    if(!Skip())
+    {
+      return false;
+    }
+    item = Next();
+    if(item == MQTT_ITEM_END)
+    {
+      // Klíč bez hodnoty
+      Fail();
+      return false;
+    }
+    if(item == MQTT_ITEM_NONE)
+    {
+      return false;
+    }
+    if(match)
+    {
+      return true;
+    }
+    if(!Skip())
+    {
+      return false;
+    }
+  }
+}
+
+int32_t MQTTPayloadReader::GetInt()
+{
+  return GetFixed(0);
+}
+
+int32_t MQTTPayloadReader::GetFixed(uint8_t scaleDecimals)
+{
+  scaleDecimals = min(scaleDecimals, (uint8_t)MQTT_PAYLOAD_MAX_DECIMALS);
+  if(type == MQTT_ITEM_FLOAT)
+  {
+    float scaled = floatValue * Pow10(scaleDecimals);
+    if(isnan(scaled))
+    {
+      return 0;
+    }
+    scaled = constrain(scaled, -2147483520.0f, 2147483520.0f);
+    return (int32_t)(scaled + (scaled < 0 ? -0.5f : 0.5f));
+  }
+  if(type != MQTT_ITEM_INT && type != MQTT_ITEM_FIXED && type != MQTT_ITEM_BOOL)
+  {
+    return 0;
+  }
+  if(scaleDecimals >= decimals)
+  {
+    // Mimo rozsah int32 se hodnota ořízne
+    uint32_t scale = Pow10(scaleDecimals - decimals);
+    if(Magnitude(mantissa) > 0x7FFFFFFF / scale)
+    {
+      return mantissa < 0 ? -0x7FFFFFFF - 1 : 0x7FFFFFFF;
+    }
+    return mantissa * (int32_t)scale;
+  }
+  // Méně desetinných míst: zaokrouhlení od nuly
+  uint32_t scale = Pow10(decimals - scaleDecimals);
+  uint32_t magnitude = (Magnitude(mantissa) + scale / 2) / scale;
+  return mantissa < 0 ? -(int32_t)magnitude : (int32_t)magnitude;
+}
+
+float MQTTPayloadReader::GetFloat()
+{
+  if(type == MQTT_ITEM_FLOAT)
+  {
+    return floatValue;
+  }
+  if(type != MQTT_ITEM_INT && type != MQTT_ITEM_FIXED && type != MQTT_ITEM_BOOL)
+  {
+    return 0;
+  }
+  return (float)mantissa / Pow10(decimals);
+}
+
+bool MQTTPayloadReader::GetBool()
+{
+  return type == MQTT_ITEM_BOOL && mantissa != 0;
+}
+
+const char* MQTTPayloadReader::GetText()
+{
+  return type == MQTT_ITEM_TEXT ? text : nullptr;
+}
+
+uint16_t MQTTPayloadReader::GetTextLength()
+{
+  return type == MQTT_ITEM_TEXT ? count : 0;
+}
+
+bool MQTTPayloadReader::TextEquals(const char* value)
+{
+  return type == MQTT_ITEM_TEXT && strlen(value) == count && memcmp(text, value, count) == 0;
+}
+
+uint16_t MQTTPayloadReader::GetCount()
+{
+  return type == MQTT_ITEM_MAP || type == MQTT_ITEM_ARRAY ? count : 0;
+}
+
+uint8_t MQTTPayloadReader::GetDepth()
+{
+  return depth;
+}
+
+bool MQTTPayloadReader::IsValid()
+{
+  return !error;
+}
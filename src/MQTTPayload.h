@@ -0,0 +1,148 @@
+#ifndef __MQTTPAYLOAD_H
+#define __MQTTPAYLOAD_H
+
+#include <Arduino.h>
+
+enum MQTTPayloadFormat
+{
+  MQTT_PAYLOAD_CBOR = 0,  // RFC 8949
+  MQTT_PAYLOAD_JSON       // bez mezer, čísla bez exponentu
+};
+
+enum MQTTPayloadItem
+{
+  MQTT_ITEM_NONE = 0,   // konec dat nebo chyba (IsValid)
+  MQTT_ITEM_INT,
+  MQTT_ITEM_FIXED,      // desetinné číslo bez zaokrouhlení (JSON 21.5, CBOR tag 4)
+  MQTT_ITEM_FLOAT,
+  MQTT_ITEM_TEXT,       // i CBOR byte string
+  MQTT_ITEM_BOOL,
+  MQTT_ITEM_NULL,
+  MQTT_ITEM_MAP,
+  MQTT_ITEM_ARRAY,
+  MQTT_ITEM_END         // konec mapy nebo pole
+};
+
+// Největší vnoření map a polí
+#ifndef MQTT_PAYLOAD_MAX_DEPTH
+#define MQTT_PAYLOAD_MAX_DEPTH 8
+#endif
+
+// Počet položek mapy nebo pole předem neznámý (v CBOR o 1 B delší)
+#define MQTT_PAYLOAD_INDEFINITE 0xFFFF
+
+#define MQTT_PAYLOAD_MAX_DECIMALS 9
+
+/*
+  Zápis typovaných hodnot jako CBOR nebo JSON bez printf a bez pomocného bufferu.
+  Hodnoty v mapě se zapisují Key(...) a hned potom hodnota, mapa/pole končí End().
+  Bez bufferu (jen formát) jde o průchod naprázdno: stejný kód spočítá délku, nic nezapíše.
+  Při nedostatku místa se dál počítá délka (GetLength je pak potřebná velikost) a IsValid vrátí false.
+*/
+class MQTTPayloadWriter
+{
+  static_assert(MQTT_PAYLOAD_MAX_DEPTH <= 8, "Writer keeps one bit per level in uint8_t");
+
+  private:
+    uint8_t* buffer;
+    uint16_t capacity;
+    uint16_t length = 0;
+    MQTTPayloadFormat format;
+    bool sizing;
+    bool error = false;
+    uint8_t depth = 0;
+    // Bit i: úroveň i je mapa / má už položku / (CBOR) je bez počtu
+    uint8_t mapLevels = 0;
+    uint8_t nonEmptyLevels = 0;
+    uint8_t indefiniteLevels = 0;
+    bool afterKey = false;
+
+    void Put(uint8_t b);
+    void Put(const uint8_t* data, uint16_t length);
+    void PutHead(uint8_t major, uint32_t value);
+    void PutDecimal(uint32_t value);
+    void PutInt(int32_t value);
+    void PutFixed(int32_t value, uint8_t decimals);
+    void BeginValue(bool key);
+    void Begin(bool map, uint16_t count);
+    void WriteText(const char* value, uint16_t length);
+
+  public:
+    // Průchod naprázdno, jen délka
+    MQTTPayloadWriter(MQTTPayloadFormat format);
+    MQTTPayloadWriter(uint8_t* buffer, uint16_t capacity, MQTTPayloadFormat format);
+    void BeginMap(uint16_t count = MQTT_PAYLOAD_INDEFINITE);
+    void BeginArray(uint16_t count = MQTT_PAYLOAD_INDEFINITE);
+    void End();
+    void Key(const char* key);
+    void Int(int32_t value);
+    // value / 10^decimals, např. Fixed(215, 1) = 21.5
+    void Fixed(int32_t value, uint8_t decimals);
+    // JSON: zaokrouhleno na decimals míst; CBOR: half float, když je přesný, jinak float
+    void Float(float value, uint8_t decimals);
+    void Text(const char* value);
+    void Text(const char* value, uint16_t length);
+    void Bool(bool value);
+    void Null();
+    uint16_t GetLength();
+    const uint8_t* GetBuffer();
+    MQTTPayloadFormat GetFormat();
+    // Vše se vešlo a mapy/pole jsou uzavřené
+    bool IsValid();
+};
+
+/*
+  Čtení CBOR nebo JSON přímo z přijatého payloadu, bez kopírování. Next() přejde na další
+  položku (klíče v mapě jsou položky MQTT_ITEM_TEXT), uzavření mapy/pole vrací MQTT_ITEM_END.
+  Text ukazuje do payloadu a nekončí '\0'; escape sekvence JSON se nedekódují.
+*/
+class MQTTPayloadReader
+{
+  private:
+    const uint8_t* data;
+    uint16_t length;
+    uint16_t pos = 0;
+    MQTTPayloadFormat format;
+    bool error = false;
+    uint8_t depth = 0;
+    // CBOR: zbývající položky na úrovni (mapa počítá klíče i hodnoty)
+    uint16_t remaining[MQTT_PAYLOAD_MAX_DEPTH];
+    MQTTPayloadItem type = MQTT_ITEM_NONE;
+    int32_t mantissa = 0;
+    uint8_t decimals = 0;
+    float floatValue = 0;
+    const char* text = nullptr;
+    uint16_t count = 0;
+
+    MQTTPayloadItem Fail();
+    bool Push(uint16_t items);
+    bool ReadHead(uint8_t* major, uint32_t* value, bool* indefinite);
+    bool ReadCborInt(int32_t* value);
+    MQTTPayloadItem NextCbor();
+    MQTTPayloadItem NextJson();
+    MQTTPayloadItem ReadJsonNumber();
+    bool ReadJsonLiteral(const char* literal);
+
+  public:
+    MQTTPayloadReader(const uint8_t* data, uint16_t length, MQTTPayloadFormat format);
+    MQTTPayloadItem Next();
+    MQTTPayloadItem GetType();
+    // Po MQTT_ITEM_MAP/ARRAY přeskočí celý obsah včetně END
+    bool Skip();
+    // V aktuální mapě najde klíč a přejde na jeho hodnotu; bez úspěchu je mapa dočtená
+    bool Find(const char* key);
+    int32_t GetInt();
+    // Číslo jako value * 10^decimals
+    int32_t GetFixed(uint8_t decimals);
+    float GetFloat();
+    bool GetBool();
+    const char* GetText();
+    uint16_t GetTextLength();
+    bool TextEquals(const char* value);
+    // Počet položek mapy/pole, MQTT_PAYLOAD_INDEFINITE když není předem známý (JSON vždy)
+    uint16_t GetCount();
+    uint8_t GetDepth();
+    bool IsValid();
+};
+
+#endif
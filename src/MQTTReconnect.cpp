@@ -0,0 +1,206 @@
+#include "MQTTReconnect.h"
+
+ReconnectBackoff::ReconnectBackoff(unsigned long base, unsigned long maxDelay)
+{
+  this->base = base;
+  this->maxDelay = maxDelay;
+  this->interval = 0;
+  this->last = 0;
+  this->failures = 0;
+}
+
+bool ReconnectBackoff::Ready(unsigned long now)
+{
+  return failures == 0 || now - last >= interval;
+}
+
+void ReconnectBackoff::Fail(unsigned long now)
+{
+  failures = failures == 255 ? failures : failures + 1;
+  interval = min(interval * 2 + random(base / 2, base), maxDelay);
+  last = now;
+}
+
+void ReconnectBackoff::Reset()
+{
+  failures = 0;
+  interval = 0;
+}
+
+MQTTReconnect::MQTTReconnect(EspDrv* drv, MQTTClient* client, const char* ssid, const char* password, MQTTConnectData connectData)
+  : wifi(5000, 300000), tcp(1000, 60000), mqtt(2000, 120000)
+{
+  this->drv = drv;
+  this->client = client;
+  this->ssid = ssid;
+  this->password = password;
+  this->connectData = connectData;
+}
+
+uint8_t MQTTReconnect::DetectLayer()
+{
+  if(drv->GetConnectionStatus() != WL_CONNECTED)
+  {
+    return RECONNECT_WIFI;
+  }
+  if(drv->GetClientStatus() != CL_CONNECTED)
+  {
+    return RECONNECT_TCP;
+  }
+  return RECONNECT_MQTT;
+}
+
+const char* MQTTReconnect::BrokerAddress()
+{
+  if(!brokerIpValid)
+  {
+    brokerIpValid = drv->ResolveHost(connectData.url, brokerIp, sizeof(brokerIp));
+  }
+  return brokerIpValid ? brokerIp : connectData.url;
+}
+
+void MQTTReconnect::InvalidateBrokerAddress()
+{
+  brokerIpValid = false;
+  dnsFailures = 0;
+}
+
+void MQTTReconnect::Recovered(unsigned long now)
+{
+  if(!recovering)
+  {
+    return;
+  }
+  recovering = false;
+  lastRecoveryTime = now - lostAt;
+  maxRecoveryTime = max(maxRecoveryTime, lastRecoveryTime);
+  totalRecoveryTime += lastRecoveryTime;
+  recoveryCount++;
+}
+
+bool MQTTReconnect::Loop()
+{
+  if(!prepared)
+  {
+    prepared = client->PrepareConnect(connectData);
+  }
+  if(layer == RECONNECT_CONNECTED)
+  {
+    if(client->Loop())
+    {
+      return true;
+    }
+    lostAt = millis();
+    recovering = true;
+    layer = DetectLayer();
+  }
+  else
+  {
+    drv->Loop();
+    if(layer == RECONNECT_UNKNOWN)
+    {
+      layer = DetectLayer();
+      // Po rychlém startu může TCP spojení k brokeru stále existovat
+      if(layer == RECONNECT_MQTT && prepared)
+      {
+        if(client->Resume())
+        {
+          layer = RECONNECT_CONNECTED;
+          if(Connected != nullptr)
+          {
+            Connected();
+          }
+          return true;
+        }
+        layer = RECONNECT_TCP;
+      }
+    }
+  }
+  unsigned long now = millis();
+  switch(layer)
+  {
+    case RECONNECT_WIFI:
+      if(!wifi.Ready(now))
+      {
+        break;
+      }
+      if(drv->Connect(ssid, password) != WL_CONNECTED)
+      {
+        wifi.Fail(millis());
+        break;
+      }
+      wifi.Reset();
+      layer = RECONNECT_TCP;
+      // fall through - Wi-Fi je připojené, hned se zkusí TCP
+    case RECONNECT_TCP:
+      // Po odmítnutém nebo neúspěšném přihlášení se spojení otevře až s dalším pokusem o něj
+      if(!tcp.Ready(now) || !mqtt.Ready(now))
+      {
+        break;
+      }
+      if(drv->GetConnectionStatus() != WL_CONNECTED)
+      {
+        layer = RECONNECT_WIFI;
+        break;
+      }
+      if(drv->TCPConnect(BrokerAddress(), connectData.port) != CL_CONNECTED)
+      {
+        tcp.Fail(millis());
+        // tcp.failures se zastaví na 255, adresa se počítá zvlášť
+        if(++dnsFailures >= RECONNECT_DNS_RETRY)
+        {
+          InvalidateBrokerAddress();
+        }
+        break;
+      }
+      tcp.Reset();
+      dnsFailures = 0;
+      layer = RECONNECT_MQTT;
+      // fall through - TCP je otevřené, hned se zkusí přihlášení
+    case RECONNECT_MQTT:
+      if(!mqtt.Ready(now) || !prepared)
+      {
+        break;
+      }
+      if(!client->Login())
+      {
+        mqtt.Fail(millis());
+        layer = DetectLayer();
+        break;
+      }
+      mqtt.Reset();
+      layer = RECONNECT_CONNECTED;
+      Recovered(millis());
+      if(Connected != nullptr)
+      {
+        Connected();
+      }
+    break;
+  }
+  return layer == RECONNECT_CONNECTED;
+}
+
+uint8_t MQTTReconnect::GetLayer()
+{
+  return layer;
+}
+
+unsigned long MQTTReconnect::GetLastRecoveryTime()
+{
+  return lastRecoveryTime;
+}
+
+unsigned long MQTTReconnect::GetMeanRecoveryTime()
+{
+  return recoveryCount == 0 ? 0 : totalRecoveryTime / recoveryCount;
+}
+
+unsigned long MQTTReconnect::GetMaxRecoveryTime()
+{
+  return maxRecoveryTime;
+}
+
+uint16_t MQTTReconnect::GetRecoveryCount()
+{
+  return recoveryCount;
+}
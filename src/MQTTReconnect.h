@@ -0,0 +1,72 @@
+#ifndef __MQTTRECONNECT_H
+#define __MQTTRECONNECT_H
+
+#include "EspDrv.h"
+#include "MQTTClient.h"
+
+#define RECONNECT_WIFI 0
+#define RECONNECT_TCP 1
+#define RECONNECT_MQTT 2
+#define RECONNECT_CONNECTED 3
+#define RECONNECT_UNKNOWN 255
+
+// Po tolika neúspěšných TCP pokusech se znovu přeloží adresa brokera
+#ifndef RECONNECT_DNS_RETRY
+#define RECONNECT_DNS_RETRY 3
+#endif
+
+struct ReconnectBackoff
+{
+  unsigned long base;
+  unsigned long maxDelay;
+  unsigned long interval;
+  unsigned long last;
+  uint8_t failures;
+
+  ReconnectBackoff(unsigned long base, unsigned long maxDelay);
+  bool Ready(unsigned long now);
+  void Fail(unsigned long now);
+  void Reset();
+};
+
+class MQTTReconnect
+{
+  private:
+    EspDrv* drv;
+    MQTTClient* client;
+    const char* ssid;
+    const char* password;
+    MQTTConnectData connectData;
+    uint8_t layer = RECONNECT_UNKNOWN;
+    ReconnectBackoff wifi;
+    ReconnectBackoff tcp;
+    ReconnectBackoff mqtt;
+    char brokerIp[16];
+    bool brokerIpValid = false;
+    // Neúspěšné TCP pokusy od posledního překladu adresy brokera
+    uint8_t dnsFailures = 0;
+    bool prepared = false;
+    bool recovering = false;
+    unsigned long lostAt = 0;
+    unsigned long lastRecoveryTime = 0;
+    unsigned long maxRecoveryTime = 0;
+    unsigned long totalRecoveryTime = 0;
+    uint16_t recoveryCount = 0;
+
+    uint8_t DetectLayer();
+    const char* BrokerAddress();
+    void Recovered(unsigned long now);
+
+  public:
+    MQTTReconnect(EspDrv* drv, MQTTClient* client, const char* ssid, const char* password, MQTTConnectData connectData);
+    bool Loop();
+    void (*Connected)() = nullptr;
+    uint8_t GetLayer();
+    void InvalidateBrokerAddress();
+    unsigned long GetLastRecoveryTime();
+    unsigned long GetMeanRecoveryTime();
+    unsigned long GetMaxRecoveryTime();
+    uint16_t GetRecoveryCount();
+};
+
+#endif
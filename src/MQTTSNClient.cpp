@@ -0,0 +1,743 @@
+#include "MQTTSNClient.h"
+#include <avr/wdt.h>
+
+static MQTTSNClient* MQTTSNClient::active = nullptr;
+
+static void MQTTSNClient::DataReceived(uint8_t* data, int length)
+{
+  // Callback ovladače je obyčejná funkce, předává se poslednímu vytvořenému klientovi
+  if(active != nullptr)
+  {
+    active->Received(data, length);
+  }
+}
+
+MQTTSNClient::MQTTSNClient(EspDrv *espDriver, void(*callback)(char* topic, uint8_t* payload, uint16_t plength), uint8_t topicCapacity = 8)
+{
+  this->client = espDriver;
+  this->client->DataReceived = &DataReceived;
+  this->callback = callback;
+  this->buffer = new uint8_t[bufferSize];
+  this->topics = new MQTTSNTopic[topicCapacity];
+  this->topicCapacity = topicCapacity;
+  active = this;
+}
+
+void MQTTSNClient::Received(uint8_t* data, uint16_t length)
+{
+  lastInActivity = millis();
+  uint8_t headerLength = data[0] == 0x01 ? 3 : 1;
+  if(length < headerLength + 1)
+  {
+    return;
+  }
+  uint8_t type = data[headerLength];
+  uint8_t* message = data + headerLength + 1;
+  length -= headerLength + 1;
+  // Odpověď se převezme, jen pokud na ni Request čeká
+  uint16_t msgId = 0;
+  uint16_t topicId = 0;
+  uint8_t returnCode = MQTTSN_RC_ACCEPTED;
+  switch(type)
+  {
+    case MQTTSN_CONNACK:
+      if(length < 1)
+      {
+        return;
+      }
+      returnCode = message[0];
+    break;
+    case MQTTSN_REGACK:
+    case MQTTSN_PUBACK:
+      if(length < 5)
+      {
+        return;
+      }
+      topicId = (message[0] << 8) | message[1];
+      msgId = (message[2] << 8) | message[3];
+      returnCode = message[4];
+      if(type == MQTTSN_PUBACK && returnCode != MQTTSN_RC_ACCEPTED)
+      {
+        rejectedPublishes++;
+        // Brána id zapomněla (např. po restartu), při dalším Publish se téma znovu zaregistruje
+        int index = FindTopic(topicId, MQTTSN_TOPIC_NORMAL);
+        if(returnCode == MQTTSN_RC_INVALID_TOPIC && index >= 0)
+        {
+          RemoveTopic(index);
+        }
+      }
+    break;
+    case MQTTSN_SUBACK:
+      if(length < 6)
+      {
+        return;
+      }
+      topicId = (message[1] << 8) | message[2];
+      msgId = (message[3] << 8) | message[4];
+      returnCode = message[5];
+    break;
+    case MQTTSN_PINGRESP:
+      if(pingOutstanding)
+      {
+        // Karn: u opakovaného PINGREQ není jasné, ke kterému odpověď patří
+        if(pingRetries == 0)
+        {
+          rtt.Sample((long)(lastInActivity - pingSent) > 0 ? lastInActivity - pingSent : 0);
+        }
+        pingOutstanding = false;
+        pingRetries = 0;
+      }
+    break;
+    case MQTTSN_DISCONNECT:
+      if(awaitType != MQTTSN_DISCONNECT)
+      {
+        // Brána klienta odpojila sama
+        isConnected = false;
+        asleep = false;
+        return;
+      }
+    break;
+    case MQTTSN_PUBLISH:
+      ReceivedPublish(message, length);
+    return;
+    case MQTTSN_REGISTER:
+      ReceivedRegister(message, length);
+    return;
+    default:
+    return;
+  }
+  if(type == awaitType && msgId == awaitMsgId)
+  {
+    responseTopicId = topicId;
+    responseCode = returnCode;
+    responseReceived = true;
+    responseTime = lastInActivity;
+  }
+}
+
+void MQTTSNClient::ReceivedPublish(uint8_t* message, uint16_t length)
+{
+  // Flags, id tématu (2 B), id zprávy (2 B), data
+  if(length < 5)
+  {
+    return;
+  }
+  uint8_t flags = message[0];
+  uint16_t topicId = (message[1] << 8) | message[2];
+  uint16_t msgId = (message[3] << 8) | message[4];
+  char* topic;
+  if((flags & 0x03) == MQTTSN_TOPIC_SHORT)
+  {
+    shortTopic[0] = message[1];
+    shortTopic[1] = message[2];
+    shortTopic[2] = '\0';
+    topic = shortTopic;
+  }
+  else
+  {
+    int index = FindTopic(topicId, flags & 0x03);
+    if(index < 0)
+    {
+      QueueAck(MQTTSN_PUBACK, topicId, msgId, MQTTSN_RC_INVALID_TOPIC);
+      return;
+    }
+    topic = (char*)topics[index].name;
+  }
+  if((flags & 0x60) == MQTTSN_FLAG_QOS1)
+  {
+    QueueAck(MQTTSN_PUBACK, topicId, msgId, MQTTSN_RC_ACCEPTED);
+  }
+  callback(topic, message + 5, length - 5);
+}
+
+void MQTTSNClient::ReceivedRegister(uint8_t* message, uint16_t length)
+{
+  // Brána registruje téma před první zprávou na odběr se zástupnými znaky
+  if(length < 5)
+  {
+    return;
+  }
+  uint16_t topicId = (message[0] << 8) | message[1];
+  uint16_t msgId = (message[2] << 8) | message[3];
+  uint8_t returnCode = MQTTSN_RC_ACCEPTED;
+  if(FindTopic(topicId, MQTTSN_TOPIC_NORMAL) < 0)
+  {
+    char* name = topicCount < topicCapacity ? new char[length - 3] : nullptr;
+    if(name == nullptr)
+    {
+      returnCode = MQTTSN_RC_CONGESTION;
+    }
+    else
+    {
+      memcpy(name, message + 4, length - 4);
+      name[length - 4] = '\0';
+      AddTopic(name, topicId, MQTTSN_TOPIC_NORMAL, true);
+    }
+  }
+  QueueAck(MQTTSN_REGACK, topicId, msgId, returnCode);
+}
+
+void MQTTSNClient::QueueAck(uint8_t type, uint16_t topicId, uint16_t msgId, uint8_t returnCode)
+{
+  // Posílá se až z Loop, ne uprostřed čekání ovladače; při plné frontě brána zprávu zopakuje
+  if(ackCount == MQTTSN_ACK_QUEUE)
+  {
+    return;
+  }
+  MQTTSNAck& ack = acks[ackCount++];
+  ack.type = type;
+  ack.topicId = topicId;
+  ack.msgId = msgId;
+  ack.returnCode = returnCode;
+}
+
+void MQTTSNClient::FlushAcks()
+{
+  uint8_t packet[MQTTSN_MAX_HEADER_SIZE + 5];
+  for(uint8_t i = 0; i < ackCount; i++)
+  {
+    packet[MQTTSN_MAX_HEADER_SIZE] = acks[i].topicId >> 8;
+    packet[MQTTSN_MAX_HEADER_SIZE + 1] = acks[i].topicId & 0xFF;
+    packet[MQTTSN_MAX_HEADER_SIZE + 2] = acks[i].msgId >> 8;
+    packet[MQTTSN_MAX_HEADER_SIZE + 3] = acks[i].msgId & 0xFF;
+    packet[MQTTSN_MAX_HEADER_SIZE + 4] = acks[i].returnCode;
+    Write(acks[i].type, packet, 5);
+  }
+  ackCount = 0;
+}
+
+bool MQTTSNClient::Open(const char* url, uint16_t port, uint16_t localPort)
+{
+  return this->client->UDPConnect(url, port, localPort) == CL_CONNECTED;
+}
+
+bool MQTTSNClient::Connect(MQTTSNConnectData connectData)
+{
+  this->clientId = connectData.id;
+  this->keepAlive = connectData.keepAlive;
+  this->connectFlags = connectData.cleanSession ? MQTTSN_FLAG_CLEAN : 0;
+  this->asleep = false;
+  if(!Open(connectData.url, connectData.port, connectData.localPort))
+  {
+    return false;
+  }
+  return Login();
+}
+
+bool MQTTSNClient::Login()
+{
+  // Čistá relace: brána zapomněla registrace, probuzení ze spánku je zachovává
+  if((connectFlags & MQTTSN_FLAG_CLEAN) && !asleep)
+  {
+    ClearRegisteredTopics();
+  }
+  uint16_t idLength = strnlen(clientId, 23);
+  uint16_t length = MQTTSN_MAX_HEADER_SIZE;
+  this->buffer[length++] = connectFlags;
+  this->buffer[length++] = MQTTSN_PROTOCOL_ID;
+  this->buffer[length++] = keepAlive >> 8;
+  this->buffer[length++] = keepAlive & 0xFF;
+  memcpy(this->buffer + length, clientId, idLength);
+  length += idLength;
+  pingOutstanding = false;
+  isConnected = false;
+  if(Request(MQTTSN_CONNECT, length - MQTTSN_MAX_HEADER_SIZE, MQTTSN_CONNACK, 0))
+  {
+    isConnected = responseCode == MQTTSN_RC_ACCEPTED;
+  }
+  if(isConnected)
+  {
+    asleep = false;
+  }
+  return isConnected;
+}
+
+void MQTTSNClient::Disconnect()
+{
+  if(!isConnected && !asleep)
+  {
+    return;
+  }
+  isConnected = false;
+  asleep = false;
+  Write(MQTTSN_DISCONNECT, buffer, 0);
+}
+
+bool MQTTSNClient::Sleep(uint16_t duration)
+{
+  // Brána po dobu duration (s) drží zprávy pro klienta, CheckIn je musí stihnout vyzvednout
+  if(!isConnected)
+  {
+    return false;
+  }
+  buffer[MQTTSN_MAX_HEADER_SIZE] = duration >> 8;
+  buffer[MQTTSN_MAX_HEADER_SIZE + 1] = duration & 0xFF;
+  if(!Request(MQTTSN_DISCONNECT, 2, MQTTSN_DISCONNECT, 0))
+  {
+    return false;
+  }
+  isConnected = false;
+  pingOutstanding = false;
+  asleep = true;
+  return true;
+}
+
+bool MQTTSNClient::CheckIn()
+{
+  // PINGREQ s id klienta; brána pošle uložené zprávy a pak PINGRESP
+  if(!asleep)
+  {
+    return false;
+  }
+  uint16_t idLength = strnlen(clientId, 23);
+  memcpy(buffer + MQTTSN_MAX_HEADER_SIZE, clientId, idLength);
+  bool result = Request(MQTTSN_PINGREQ, idLength, MQTTSN_PINGRESP, 0);
+  FlushAcks();
+  return result;
+}
+
+bool MQTTSNClient::Write(uint8_t type, uint8_t* buf, uint16_t length)
+{
+  // Zpráva začíná na buf + MQTTSN_MAX_HEADER_SIZE, hlavička se doplní před ni
+  uint16_t total = length + 2;
+  uint8_t* start = buf + MQTTSN_MAX_HEADER_SIZE - 2;
+  if(total < 256)
+  {
+    start[0] = total;
+  }
+  else
+  {
+    total += 2;
+    start = buf;
+    start[0] = 0x01;
+    start[1] = total >> 8;
+    start[2] = total & 0xFF;
+  }
+  buf[MQTTSN_MAX_HEADER_SIZE - 1] = type;
+  bool result = this->client->Write(start, total);
+  OutActivity(millis());
+  return result;
+}
+
+bool MQTTSNClient::Request(uint8_t type, uint16_t length, uint8_t responseType, uint16_t msgId)
+{
+  // UDP nic neopakuje, požadavek se pošle znovu po RetryTimeout
+  bool result = false;
+  for(uint8_t attempt = 0; attempt <= MQTTSN_RETRY_COUNT && !result; attempt++)
+  {
+    if(attempt > 0)
+    {
+      retransmissions++;
+      if(type == MQTTSN_SUBSCRIBE)
+      {
+        buffer[MQTTSN_MAX_HEADER_SIZE] |= MQTTSN_FLAG_DUP;
+      }
+    }
+    awaitType = responseType;
+    awaitMsgId = msgId;
+    responseReceived = false;
+    unsigned long timeout = RetryTimeout();
+    // Odpověď může přijít už během Write (před SEND OK), čas se proto bere před zápisem.
+    // RTT i čekání na odpověď se počítají od začátku dat, ne od návratu z Write.
+    unsigned long t = millis();
+    Write(type, buffer, length);
+    unsigned long start = client->GetDataStart();
+    if((long)(start - t) < 0)
+    {
+      start = t;
+    }
+    while(!responseReceived && millis() - start < timeout)
+    {
+      wdt_reset();
+      client->Loop();
+    }
+    result = responseReceived;
+    if(result && attempt == 0)
+    {
+      rtt.Sample((long)(responseTime - start) > 0 ? responseTime - start : 0);
+    }
+  }
+  awaitType = 0xFF;
+  return result;
+}
+
+uint16_t MQTTSNClient::NextMsgId()
+{
+  nextMsgId++;
+  if(nextMsgId == 0)
+  {
+    nextMsgId = 1;
+  }
+  return nextMsgId;
+}
+
+uint16_t MQTTSNClient::WriteTopic(const char* topic, uint8_t* buf, uint16_t pos)
+{
+  // Jméno tématu v MQTT-SN nemá délku, končí koncem zprávy
+  while(*topic)
+  {
+    buf[pos++] = *topic++;
+  }
+  return pos;
+}
+
+int MQTTSNClient::FindTopic(const char* name)
+{
+  for(uint8_t i = 0; i < topicCount; i++)
+  {
+    if(strcmp(topics[i].name, name) == 0)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int MQTTSNClient::FindTopic(uint16_t id, uint8_t type)
+{
+  for(uint8_t i = 0; i < topicCount; i++)
+  {
+    if(topics[i].id == id && topics[i].type == type)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool MQTTSNClient::AddTopic(const char* name, uint16_t id, uint8_t type, bool ownsName)
+{
+  if(topicCount == topicCapacity)
+  {
+    return false;
+  }
+  MQTTSNTopic& topic = topics[topicCount++];
+  topic.name = name;
+  topic.id = id;
+  topic.type = type;
+  topic.ownsName = ownsName;
+  return true;
+}
+
+void MQTTSNClient::RemoveTopic(uint8_t index)
+{
+  if(topics[index].ownsName)
+  {
+    delete[] (char*)topics[index].name;
+  }
+  topicCount--;
+  for(; index < topicCount; index++)
+  {
+    topics[index] = topics[index + 1];
+  }
+}
+
+void MQTTSNClient::ClearRegisteredTopics()
+{
+  // Předdefinovaná témata zůstávají
+  uint8_t i = 0;
+  while(i < topicCount)
+  {
+    if(topics[i].type == MQTTSN_TOPIC_NORMAL)
+    {
+      RemoveTopic(i);
+    }
+    else
+    {
+      i++;
+    }
+  }
+}
+
+bool MQTTSNClient::ResolveTopic(const char* topic, uint16_t* id, uint8_t* type, bool registerNew)
+{
+  if(strlen(topic) == 2 && strchr(topic, '#') == nullptr && strchr(topic, '+') == nullptr)
+  {
+    *id = ((uint8_t)topic[0] << 8) | (uint8_t)topic[1];
+    *type = MQTTSN_TOPIC_SHORT;
+    return true;
+  }
+  int index = FindTopic(topic);
+  if(index >= 0)
+  {
+    *id = topics[index].id;
+    *type = topics[index].type;
+    return true;
+  }
+  *type = MQTTSN_TOPIC_NORMAL;
+  return registerNew && Register(topic, id);
+}
+
+bool MQTTSNClient::Register(const char* topic, uint16_t* topicId)
+{
+  int index = FindTopic(topic);
+  if(index >= 0)
+  {
+    if(topicId != nullptr)
+    {
+      *topicId = topics[index].id;
+    }
+    return true;
+  }
+  uint16_t topicLength = strnlen(topic, this->bufferSize);
+  if(!isConnected || topicCount == topicCapacity || this->bufferSize < MQTTSN_MAX_HEADER_SIZE + 4 + topicLength)
+  {
+    return false;
+  }
+  uint16_t msgId = NextMsgId();
+  uint16_t length = MQTTSN_MAX_HEADER_SIZE;
+  this->buffer[length++] = 0;
+  this->buffer[length++] = 0;
+  this->buffer[length++] = msgId >> 8;
+  this->buffer[length++] = msgId & 0xFF;
+  length = WriteTopic(topic, this->buffer, length);
+  if(!Request(MQTTSN_REGISTER, length - MQTTSN_MAX_HEADER_SIZE, MQTTSN_REGACK, msgId) || responseCode != MQTTSN_RC_ACCEPTED)
+  {
+    return false;
+  }
+  AddTopic(topic, responseTopicId, MQTTSN_TOPIC_NORMAL, false);
+  if(topicId != nullptr)
+  {
+    *topicId = responseTopicId;
+  }
+  return true;
+}
+
+bool MQTTSNClient::SetPredefinedTopic(const char* topic, uint16_t topicId)
+{
+  int index = FindTopic(topic);
+  if(index >= 0)
+  {
+    RemoveTopic(index);
+  }
+  return AddTopic(topic, topicId, MQTTSN_TOPIC_PREDEFINED, false);
+}
+
+bool MQTTSNClient::Subscribe(const char* topic)
+{
+  return Subscribe(topic, 0);
+}
+
+bool MQTTSNClient::Subscribe(const char* topic, uint8_t qos)
+{
+  if(!isConnected || topic == nullptr || qos > 1)
+  {
+    return false;
+  }
+  uint16_t topicLength = strnlen(topic, this->bufferSize);
+  if(this->bufferSize < MQTTSN_MAX_HEADER_SIZE + 3 + topicLength)
+  {
+    return false;
+  }
+  uint16_t id;
+  uint8_t type;
+  bool known = ResolveTopic(topic, &id, &type, false);
+  uint16_t msgId = NextMsgId();
+  uint16_t length = MQTTSN_MAX_HEADER_SIZE;
+  this->buffer[length++] = (qos > 0 ? MQTTSN_FLAG_QOS1 : MQTTSN_FLAG_QOS0) | (known ? type : MQTTSN_TOPIC_NORMAL);
+  this->buffer[length++] = msgId >> 8;
+  this->buffer[length++] = msgId & 0xFF;
+  if(known && type != MQTTSN_TOPIC_NORMAL)
+  {
+    this->buffer[length++] = id >> 8;
+    this->buffer[length++] = id & 0xFF;
+  }
+  else
+  {
+    length = WriteTopic(topic, this->buffer, length);
+  }
+  if(!Request(MQTTSN_SUBSCRIBE, length - MQTTSN_MAX_HEADER_SIZE, MQTTSN_SUBACK, msgId) || responseCode != MQTTSN_RC_ACCEPTED)
+  {
+    return false;
+  }
+  // Odběr se zástupnými znaky vrací id 0, jednotlivá témata brána zaregistruje sama
+  if(!known && responseTopicId != 0)
+  {
+    AddTopic(topic, responseTopicId, MQTTSN_TOPIC_NORMAL, false);
+  }
+  return true;
+}
+
+bool MQTTSNClient::Publish(const char* topic, const char* payload)
+{
+  return Publish(topic, (const uint8_t*)payload, payload ? strnlen(payload, this->bufferSize) : 0, false);
+}
+
+bool MQTTSNClient::Publish(const char* topic, const char* payload, boolean retained)
+{
+  return Publish(topic, (const uint8_t*)payload, payload ? strnlen(payload, this->bufferSize) : 0, retained);
+}
+
+bool MQTTSNClient::Publish(const char* topic, const uint8_t* payload, unsigned int plength)
+{
+  return Publish(topic, payload, plength, false);
+}
+
+bool MQTTSNClient::Publish(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained)
+{
+  if(!isConnected)
+  {
+    Serial.println("Not connected");
+    return false;
+  }
+  if(this->bufferSize < MQTTSN_MAX_HEADER_SIZE + 5 + plength)
+  {
+    Serial.println("Small buffer size");
+    return false;
+  }
+  // Registrace používá stejný buffer, proběhne před sestavením zprávy
+  uint16_t id;
+  uint8_t type;
+  if(!ResolveTopic(topic, &id, &type, true))
+  {
+    return false;
+  }
+  uint16_t length = MQTTSN_MAX_HEADER_SIZE;
+  this->buffer[length++] = MQTTSN_FLAG_QOS0 | (retained ? MQTTSN_FLAG_RETAIN : 0) | type;
+  this->buffer[length++] = id >> 8;
+  this->buffer[length++] = id & 0xFF;
+  this->buffer[length++] = 0;
+  this->buffer[length++] = 0;
+  memcpy(this->buffer + length, payload, plength);
+  length += plength;
+  return Write(MQTTSN_PUBLISH, this->buffer, length - MQTTSN_MAX_HEADER_SIZE);
+}
+
+bool MQTTSNClient::PublishQosM1(const char* topic, const uint8_t* payload, unsigned int plength)
+{
+  if(this->bufferSize < MQTTSN_MAX_HEADER_SIZE + 5 + plength)
+  {
+    return false;
+  }
+  uint16_t id;
+  uint8_t type;
+  if(!ResolveTopic(topic, &id, &type, false) || type == MQTTSN_TOPIC_NORMAL)
+  {
+    return false;
+  }
+  uint16_t length = MQTTSN_MAX_HEADER_SIZE;
+  this->buffer[length++] = MQTTSN_FLAG_QOSM1 | type;
+  this->buffer[length++] = id >> 8;
+  this->buffer[length++] = id & 0xFF;
+  this->buffer[length++] = 0;
+  this->buffer[length++] = 0;
+  memcpy(this->buffer + length, payload, plength);
+  length += plength;
+  return Write(MQTTSN_PUBLISH, this->buffer, length - MQTTSN_MAX_HEADER_SIZE);
+}
+
+bool MQTTSNClient::Loop()
+{
+  unsigned long currentMillis = millis();
+  FlushAcks();
+  if(keepAlive > 0 && isConnected)
+  {
+    if(pingOutstanding)
+    {
+      if(currentMillis - pingSent > RetryTimeout())
+      {
+        if(pingRetries >= MQTTSN_RETRY_COUNT)
+        {
+          Serial.println("Gateway lost");
+          pingOutstanding = false;
+          isConnected = false;
+          deadLinkCount++;
+          return isConnected;
+        }
+        pingRetries++;
+        retransmissions++;
+        SendPing();
+      }
+    }
+    else if(currentMillis - lastOutActivity >= keepAlive * 1000UL)
+    {
+      pingRetries = 0;
+      SendPing();
+    }
+  }
+  this->client->Loop();
+  return isConnected;
+}
+
+void MQTTSNClient::SendPing()
+{
+  pingOutstanding = true;
+  // PINGRESP může přijít už během Write, čas odeslání se nastaví předem a zpřesní začátkem dat
+  pingSent = millis();
+  Write(MQTTSN_PINGREQ, buffer, 0);
+  if(pingOutstanding && (long)(client->GetDataStart() - pingSent) > 0)
+  {
+    pingSent = client->GetDataStart();
+  }
+  timers.Set(MQTTSN_TIMER_PING_RETRY, pingSent + RetryTimeout() + 1);
+}
+
+void MQTTSNClient::OutActivity(unsigned long now)
+{
+  lastOutActivity = now;
+  if(keepAlive > 0)
+  {
+    timers.Set(MQTTSN_TIMER_KEEPALIVE, now + keepAlive * 1000UL);
+  }
+}
+
+bool MQTTSNClient::TimerActive(uint8_t timer)
+{
+  switch(timer)
+  {
+    case MQTTSN_TIMER_KEEPALIVE:
+      return keepAlive > 0 && isConnected && !pingOutstanding;
+    case MQTTSN_TIMER_PING_RETRY:
+      return isConnected && pingOutstanding;
+  }
+  return false;
+}
+
+unsigned long MQTTSNClient::NextDeadline()
+{
+  if(ackCount > 0)
+  {
+    return 0;
+  }
+  while(!timers.Empty() && !TimerActive(timers.FirstId()))
+  {
+    timers.Cancel(timers.FirstId());
+  }
+  return min(timers.Remaining(millis()), client->NextDeadline());
+}
+
+unsigned long MQTTSNClient::RetryTimeout()
+{
+  return rtt.Timeout(MQTTSN_RETRY_TIMEOUT, MQTTSN_RETRY_TIMEOUT_MIN, MQTTSN_RETRY_TIMEOUT_MAX);
+}
+
+bool MQTTSNClient::IsConnected()
+{
+  // UDP nemá stav spojení, rozhoduje odpověď brány na CONNECT a PINGREQ
+  return isConnected;
+}
+
+bool MQTTSNClient::IsAsleep()
+{
+  return asleep;
+}
+
+const RttEstimator& MQTTSNClient::GetRtt()
+{
+  return rtt;
+}
+
+uint16_t MQTTSNClient::GetDeadLinkCount()
+{
+  return deadLinkCount;
+}
+
+uint16_t MQTTSNClient::GetRetransmissions()
+{
+  return retransmissions;
+}
+
+uint16_t MQTTSNClient::GetRejectedPublishes()
+{
+  return rejectedPublishes;
+}
@@ -0,0 +1,204 @@
+#ifndef __MQTTSNCLIENT_H
+#define __MQTTSNCLIENT_H
+
+#include "EspDrv.h"
+#include "RttEstimator.h"
+#include "DeadlineList.h"
+
+#ifndef MQTTSN_BUFFER_SIZE
+#define MQTTSN_BUFFER_SIZE 128
+#endif
+
+#ifndef MQTTSN_KEEPALIVE
+#define MQTTSN_KEEPALIVE 60
+#endif
+
+// Opakování požadavků (CONNECT, REGISTER, SUBSCRIBE, PINGREQ). Timeout se odvozuje
+// z RTT (srtt + 4 * rttvar), bez měření se použije MQTTSN_RETRY_TIMEOUT.
+#ifndef MQTTSN_RETRY_TIMEOUT
+#define MQTTSN_RETRY_TIMEOUT 3000
+#endif
+
+#ifndef MQTTSN_RETRY_TIMEOUT_MIN
+#define MQTTSN_RETRY_TIMEOUT_MIN 500
+#endif
+
+#ifndef MQTTSN_RETRY_TIMEOUT_MAX
+#define MQTTSN_RETRY_TIMEOUT_MAX 15000
+#endif
+
+#ifndef MQTTSN_RETRY_COUNT
+#define MQTTSN_RETRY_COUNT 3
+#endif
+
+// Délka (1 B, nebo 0x01 + 2 B) a typ zprávy
+#define MQTTSN_MAX_HEADER_SIZE 4
+
+#define MQTTSN_ADVERTISE      0x00
+#define MQTTSN_CONNECT        0x04
+#define MQTTSN_CONNACK        0x05
+#define MQTTSN_WILLTOPICREQ   0x06
+#define MQTTSN_WILLMSGREQ     0x08
+#define MQTTSN_REGISTER       0x0A
+#define MQTTSN_REGACK         0x0B
+#define MQTTSN_PUBLISH        0x0C
+#define MQTTSN_PUBACK         0x0D
+#define MQTTSN_SUBSCRIBE      0x12
+#define MQTTSN_SUBACK         0x13
+#define MQTTSN_PINGREQ        0x16
+#define MQTTSN_PINGRESP       0x17
+#define MQTTSN_DISCONNECT     0x18
+
+#define MQTTSN_FLAG_DUP       0x80
+#define MQTTSN_FLAG_QOS0      0x00
+#define MQTTSN_FLAG_QOS1      0x20
+#define MQTTSN_FLAG_QOSM1     0x60
+#define MQTTSN_FLAG_RETAIN    0x10
+#define MQTTSN_FLAG_CLEAN     0x04
+
+#define MQTTSN_TOPIC_NORMAL     0x00
+#define MQTTSN_TOPIC_PREDEFINED 0x01
+#define MQTTSN_TOPIC_SHORT      0x02
+
+#define MQTTSN_RC_ACCEPTED        0x00
+#define MQTTSN_RC_CONGESTION      0x01
+#define MQTTSN_RC_INVALID_TOPIC   0x02
+#define MQTTSN_RC_NOT_SUPPORTED   0x03
+
+#define MQTTSN_PROTOCOL_ID 0x01
+
+// Časovače pro NextDeadline
+#define MQTTSN_TIMER_KEEPALIVE 0
+#define MQTTSN_TIMER_PING_RETRY 1
+
+// Potvrzení čekající na odeslání z Loop (PUBACK, REGACK)
+#ifndef MQTTSN_ACK_QUEUE
+#define MQTTSN_ACK_QUEUE 4
+#endif
+
+// Řetězce se neukládají, musí platit po celou dobu běhu klienta
+struct MQTTSNConnectData
+{
+  const char* url;
+  uint16_t port;
+  uint16_t localPort;
+  const char* id;
+  boolean cleanSession;
+  uint16_t keepAlive;
+};
+
+struct MQTTSNTopic
+{
+  const char* name;
+  uint16_t id;
+  uint8_t type;
+  // Jméno přišlo v REGISTER od brány a je alokované klientem
+  bool ownsName;
+};
+
+struct MQTTSNAck
+{
+  uint8_t type;
+  uint8_t returnCode;
+  uint16_t topicId;
+  uint16_t msgId;
+};
+
+/*
+  MQTT-SN 1.2 klient přes UDP (AT+CIPSTART="UDP") s rozhraním podobným MQTTClient.
+  Témata se posílají jako 2bytová id: normální se jednou registrují (REGISTER, při Publish
+  automaticky), předdefinovaná zná brána předem, dvouznaková se posílají přímo.
+  QoS -1 (PublishQosM1) nepotřebuje CONNECT, stačí Open. Spící klient: Sleep(duration),
+  CheckIn() vyzvedne zprávy uložené bránou, Login() klienta probudí.
+  Odchozí publikace jsou QoS 0, příchozí QoS 1 se potvrzují.
+*/
+class MQTTSNClient
+{
+  private:
+    static MQTTSNClient* active;
+    EspDrv* client;
+    uint8_t* buffer;
+    uint16_t bufferSize = MQTTSN_BUFFER_SIZE;
+    MQTTSNTopic* topics;
+    uint8_t topicCapacity;
+    uint8_t topicCount = 0;
+    const char* clientId = "";
+    uint8_t connectFlags = 0;
+    uint16_t keepAlive = MQTTSN_KEEPALIVE;
+    bool isConnected = false;
+    bool asleep = false;
+    uint16_t nextMsgId = 0;
+    unsigned long lastOutActivity = 0;
+    unsigned long lastInActivity = 0;
+    bool pingOutstanding = false;
+    unsigned long pingSent = 0;
+    uint8_t pingRetries = 0;
+    uint16_t deadLinkCount = 0;
+    uint16_t retransmissions = 0;
+    uint16_t rejectedPublishes = 0;
+    DeadlineList<2> timers;
+    RttEstimator rtt;
+    // Odpověď, na kterou čeká Request
+    uint8_t awaitType = 0xFF;
+    uint16_t awaitMsgId = 0;
+    bool responseReceived = false;
+    unsigned long responseTime = 0;
+    uint8_t responseCode = 0;
+    uint16_t responseTopicId = 0;
+    char shortTopic[3];
+    MQTTSNAck acks[MQTTSN_ACK_QUEUE];
+    uint8_t ackCount = 0;
+    void (*callback)(char* topic, uint8_t* payload, uint16_t plength);
+
+    static void DataReceived(uint8_t* data, int length);
+    void Received(uint8_t* data, uint16_t length);
+    void ReceivedPublish(uint8_t* message, uint16_t length);
+    void ReceivedRegister(uint8_t* message, uint16_t length);
+    void QueueAck(uint8_t type, uint16_t topicId, uint16_t msgId, uint8_t returnCode);
+    void FlushAcks();
+    bool Write(uint8_t type, uint8_t* buf, uint16_t length);
+    bool Request(uint8_t type, uint16_t length, uint8_t responseType, uint16_t msgId);
+    uint16_t NextMsgId();
+    uint16_t WriteTopic(const char* topic, uint8_t* buf, uint16_t pos);
+    int FindTopic(const char* name);
+    int FindTopic(uint16_t id, uint8_t type);
+    bool AddTopic(const char* name, uint16_t id, uint8_t type, bool ownsName);
+    void RemoveTopic(uint8_t index);
+    void ClearRegisteredTopics();
+    bool ResolveTopic(const char* topic, uint16_t* id, uint8_t* type, bool registerNew);
+    void SendPing();
+    void OutActivity(unsigned long now);
+    bool TimerActive(uint8_t timer);
+    unsigned long RetryTimeout();
+
+  public:
+    MQTTSNClient(EspDrv *espDriver, void(*callback)(char* topic, uint8_t* payload, uint16_t plength), uint8_t topicCapacity = 8);
+    // Jen UDP spojení s bránou, bez CONNECT (pro QoS -1)
+    bool Open(const char* url, uint16_t port, uint16_t localPort);
+    bool Connect(MQTTSNConnectData connectData);
+    bool Login();
+    void Disconnect();
+    bool Sleep(uint16_t duration);
+    bool CheckIn();
+    bool Register(const char* topic, uint16_t* topicId = nullptr);
+    bool SetPredefinedTopic(const char* topic, uint16_t topicId);
+    bool Subscribe(const char* topic);
+    bool Subscribe(const char* topic, uint8_t qos);
+    bool Publish(const char* topic, const char* payload);
+    bool Publish(const char* topic, const char* payload, boolean retained);
+    bool Publish(const char* topic, const uint8_t* payload, unsigned int plength);
+    bool Publish(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained);
+    // Fire-and-forget bez CONNECT, jen pro předdefinovaná a dvouznaková témata
+    bool PublishQosM1(const char* topic, const uint8_t* payload, unsigned int plength);
+    bool Loop();
+    bool IsConnected();
+    bool IsAsleep();
+    const RttEstimator& GetRtt();
+    uint16_t GetDeadLinkCount();
+    uint16_t GetRetransmissions();
+    // PUBACK s chybou od brány (neznámé id, přetížení)
+    uint16_t GetRejectedPublishes();
+    unsigned long NextDeadline();
+};
+
+#endif
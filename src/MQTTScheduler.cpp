@@ -0,0 +1,231 @@
+#include "MQTTScheduler.h"
+
+MQTTScheduler::MQTTScheduler(EspDrv* drv, MQTTClient* client, uint8_t* storage, uint16_t storageSize, uint16_t slotSize)
+{
+  this->drv = drv;
+  this->client = client;
+  this->pool = storage;
+  this->slotSize = slotSize;
+  this->slotCount = min(storageSize / slotSize, (uint16_t)255);
+  for(uint8_t i = 0; i < slotCount; i++)
+  {
+    Slot(i)[0] = SCHED_SLOT_FREE;
+  }
+  SetRate(1000, 256, 100, 4000);
+}
+
+void MQTTScheduler::SetRate(uint16_t bytesPerSecond, uint16_t burst, uint16_t minRate, uint16_t maxRate)
+{
+  this->rate = bytesPerSecond;
+  this->burst = burst;
+  this->minRate = minRate;
+  this->maxRate = maxRate;
+  this->rateStep = max(bytesPerSecond / 10, 1);
+  // Tokeny jsou v tisícinách bytu, doplňují se po milisekundách
+  this->tokens = (long)burst * 1000;
+  this->lastRefill = millis();
+  this->busySeen = drv->GetStats().busy;
+}
+
+uint8_t* MQTTScheduler::Slot(uint8_t index)
+{
+  return pool + (uint16_t)index * slotSize;
+}
+
+bool MQTTScheduler::Publish(const char* topic, const char* payload, uint8_t priority, bool retained)
+{
+  return Publish(topic, (const uint8_t*)payload, payload ? strlen(payload) : 0, priority, retained);
+}
+
+bool MQTTScheduler::Publish(const char* topic, const uint8_t* payload, uint16_t length, uint8_t priority, bool retained)
+{
+  priority = min(priority, (uint8_t)(SCHED_CLASSES - 1));
+  uint16_t topicLen = strlen(topic);
+  if(SCHED_SLOT_HEADER + topicLen + 1 + length > slotSize)
+  {
+    stats[priority].dropped++;
+    return false;
+  }
+  int index = -1;
+  for(uint8_t i = 0; i < slotCount && index < 0; i++)
+  {
+    if(Slot(i)[0] == SCHED_SLOT_FREE)
+    {
+      index = i;
+    }
+  }
+  if(index < 0)
+  {
+    // Plná fronta: vyšší třída vytlačí nejnovější zprávu nejnižší zaplněné třídy
+    index = FindVictim(priority);
+    if(index < 0)
+    {
+      stats[priority].dropped++;
+      return false;
+    }
+    stats[Slot(index)[0]].preempted++;
+    queued--;
+  }
+  uint8_t* slot = Slot(index);
+  uint32_t now = millis();
+  slot[0] = priority;
+  slot[1] = retained;
+  slot[2] = nextSequence >> 8;
+  slot[3] = nextSequence & 0xFF;
+  memcpy(slot + 4, &now, 4);
+  slot[8] = topicLen >> 8;
+  slot[9] = topicLen & 0xFF;
+  slot[10] = length >> 8;
+  slot[11] = length & 0xFF;
+  memcpy(slot + SCHED_SLOT_HEADER, topic, topicLen + 1);
+  memcpy(slot + SCHED_SLOT_HEADER + topicLen + 1, payload, length);
+  nextSequence++;
+  queued++;
+  return true;
+}
+
+int MQTTScheduler::FindNext()
+{
+  // Nejvyšší třída, v ní nejstarší zpráva
+  int best = -1;
+  uint16_t bestAge = 0;
+  for(uint8_t i = 0; i < slotCount; i++)
+  {
+    uint8_t* slot = Slot(i);
+    if(slot[0] == SCHED_SLOT_FREE)
+    {
+      continue;
+    }
+    uint16_t age = nextSequence - ((slot[2] << 8) | slot[3]);
+    if(best < 0 || slot[0] < Slot(best)[0] || (slot[0] == Slot(best)[0] && age > bestAge))
+    {
+      best = i;
+      bestAge = age;
+    }
+  }
+  return best;
+}
+
+int MQTTScheduler::FindVictim(uint8_t priority)
+{
+  int victim = -1;
+  uint16_t victimAge = 0;
+  for(uint8_t i = 0; i < slotCount; i++)
+  {
+    uint8_t* slot = Slot(i);
+    if(slot[0] <= priority)
+    {
+      continue;
+    }
+    uint16_t age = nextSequence - ((slot[2] << 8) | slot[3]);
+    if(victim < 0 || slot[0] > Slot(victim)[0] || (slot[0] == Slot(victim)[0] && age < victimAge))
+    {
+      victim = i;
+      victimAge = age;
+    }
+  }
+  return victim;
+}
+
+void MQTTScheduler::Refill(unsigned long now)
+{
+  unsigned long elapsed = now - lastRefill;
+  lastRefill = now;
+  tokens = min(tokens + (long)min(elapsed, 60000UL) * rate, (long)burst * 1000);
+}
+
+void MQTTScheduler::Adapt(unsigned long now)
+{
+  uint16_t busy = drv->GetStats().busy;
+  if(busy != busySeen)
+  {
+    // Modul nestíhá: rychlost na polovinu a vyprázdnit bucket
+    busySeen = busy;
+    rate = max(rate / 2, minRate);
+    tokens = min(tokens, 0L);
+    lastBusy = lastIncrease = now;
+    rateDecreases++;
+  }
+  else if(rate < maxRate && now - lastBusy >= SCHED_RECOVERY_INTERVAL && now - lastIncrease >= SCHED_RECOVERY_INTERVAL)
+  {
+    rate = min(rate + rateStep, maxRate);
+    lastIncrease = now;
+  }
+}
+
+bool MQTTScheduler::Send(uint8_t index, unsigned long now)
+{
+  uint8_t* slot = Slot(index);
+  uint8_t priority = slot[0];
+  uint16_t topicLen = (slot[8] << 8) | slot[9];
+  uint16_t length = (slot[10] << 8) | slot[11];
+  // Odhad bytů na UARTu: pevná hlavička, délka topicu, topic, payload a režie AT+CIPSEND
+  long cost = (long)(SCHED_SEND_OVERHEAD + 4 + topicLen + length) * 1000;
+  if(priority != SCHED_CRITICAL && tokens < cost)
+  {
+    return false;
+  }
+  char* topic = (char*)(slot + SCHED_SLOT_HEADER);
+  if(!client->Publish(topic, slot + SCHED_SLOT_HEADER + topicLen + 1, length, slot[1]))
+  {
+    if(!client->IsConnected())
+    {
+      // Zpráva počká na obnovení spojení
+      return false;
+    }
+    stats[priority].dropped++;
+  }
+  else
+  {
+    uint32_t enqueued;
+    memcpy(&enqueued, slot + 4, 4);
+    stats[priority].sent++;
+    stats[priority].maxLatency = max(stats[priority].maxLatency, (unsigned long)((uint32_t)now - enqueued));
+    tokens -= cost;
+  }
+  slot[0] = SCHED_SLOT_FREE;
+  queued--;
+  return true;
+}
+
+uint8_t MQTTScheduler::Loop()
+{
+  unsigned long now = millis();
+  Refill(now);
+  Adapt(now);
+  uint8_t sent = 0;
+  while(queued > 0 && !drv->IsBusy())
+  {
+    int index = FindNext();
+    if(index < 0 || !Send(index, now))
+    {
+      break;
+    }
+    sent++;
+    // Odeslání trvá (UART, SEND OK), tokeny přibývají i během vyprazdňování fronty
+    now = millis();
+    Refill(now);
+    Adapt(now);
+  }
+  return sent;
+}
+
+uint8_t MQTTScheduler::GetQueued()
+{
+  return queued;
+}
+
+uint16_t MQTTScheduler::GetRate()
+{
+  return rate;
+}
+
+uint16_t MQTTScheduler::GetRateDecreases()
+{
+  return rateDecreases;
+}
+
+const SchedulerClassStats& MQTTScheduler::GetStats(uint8_t priority)
+{
+  return stats[min(priority, (uint8_t)(SCHED_CLASSES - 1))];
+}
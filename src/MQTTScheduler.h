@@ -0,0 +1,84 @@
+#ifndef __MQTTSCHEDULER_H
+#define __MQTTSCHEDULER_H
+
+#include "EspDrv.h"
+#include "MQTTClient.h"
+
+// Třídy priority, 0 je nejvyšší
+#define SCHED_CRITICAL 0
+#define SCHED_HIGH 1
+#define SCHED_NORMAL 2
+#define SCHED_LOW 3
+#define SCHED_CLASSES 4
+
+// Režie jednoho odeslání na UARTu (AT+CIPSEND, prompt, SEND OK) v bytech
+#ifndef SCHED_SEND_OVERHEAD
+#define SCHED_SEND_OVERHEAD 24
+#endif
+
+// Po tak dlouhé době bez BUSY se rychlost zvyšuje o rateStep
+#ifndef SCHED_RECOVERY_INTERVAL
+#define SCHED_RECOVERY_INTERVAL 5000
+#endif
+
+// Slot: priorita (1 B), retained (1 B), pořadí (2 B), čas zařazení (4 B), délka topicu (2 B), délka payloadu (2 B), topic s '\0', payload
+#define SCHED_SLOT_HEADER 12
+#define SCHED_SLOT_FREE 0xFF
+
+struct SchedulerClassStats
+{
+  uint16_t sent = 0;
+  uint16_t dropped = 0;
+  uint16_t preempted = 0;
+  unsigned long maxLatency = 0;
+};
+
+/*
+  Fronta publikací před MQTTClient. Odesílání omezuje token bucket (byty za sekundu),
+  jehož rychlost se při BUSY od modulu sníží na polovinu a po klidu se postupně zvyšuje.
+  Vyšší třída se odešle dřív a při plné frontě vytlačí nejnovější zprávu nižší třídy.
+  SCHED_CRITICAL se odešle i bez tokenů (bucket jde do dluhu), čeká jen na BUSY.
+*/
+class MQTTScheduler
+{
+  private:
+    EspDrv* drv;
+    MQTTClient* client;
+    uint8_t* pool;
+    uint16_t slotSize;
+    uint8_t slotCount;
+    uint8_t queued = 0;
+    uint16_t nextSequence = 0;
+    uint16_t rate;
+    uint16_t minRate;
+    uint16_t maxRate;
+    uint16_t rateStep;
+    uint16_t burst;
+    long tokens;
+    unsigned long lastRefill = 0;
+    unsigned long lastBusy = 0;
+    unsigned long lastIncrease = 0;
+    uint16_t busySeen = 0;
+    uint16_t rateDecreases = 0;
+    SchedulerClassStats stats[SCHED_CLASSES];
+
+    uint8_t* Slot(uint8_t index);
+    int FindNext();
+    int FindVictim(uint8_t priority);
+    void Refill(unsigned long now);
+    void Adapt(unsigned long now);
+    bool Send(uint8_t index, unsigned long now);
+
+  public:
+    MQTTScheduler(EspDrv* drv, MQTTClient* client, uint8_t* storage, uint16_t storageSize, uint16_t slotSize);
+    void SetRate(uint16_t bytesPerSecond, uint16_t burst, uint16_t minRate, uint16_t maxRate);
+    bool Publish(const char* topic, const char* payload, uint8_t priority = SCHED_NORMAL, bool retained = false);
+    bool Publish(const char* topic, const uint8_t* payload, uint16_t length, uint8_t priority = SCHED_NORMAL, bool retained = false);
+    uint8_t Loop();
+    uint8_t GetQueued();
+    uint16_t GetRate();
+    uint16_t GetRateDecreases();
+    const SchedulerClassStats& GetStats(uint8_t priority);
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include "MQTTTopicRegistry.h"
+
+MQTTTopicRegistry::MQTTTopicRegistry(uint8_t capacity)
+{
+  this->capacity = min(capacity, (uint8_t)(MQTT_TOPIC_NONE - 1));
+  uint16_t tableSize = 2;
+  while(tableSize < 2 * (uint16_t)this->capacity)
+  {
+    tableSize <<= 1;
+  }
+  // tableMask je uint8_t, tabulka má nejvýš 256 položek
+  tableSize = min(tableSize, (uint16_t)256);
+  this->wire = new const uint8_t*[this->capacity];
+  this->hashes = new uint16_t[this->capacity];
+  this->table = new uint8_t[tableSize];
+  this->tableMask = tableSize - 1;
+  memset(this->table, 0, tableSize);
+}
+
+uint16_t MQTTTopicRegistry::Hash(const uint8_t* name, uint16_t length)
+{
+  uint16_t hash = 5381;
+  for(uint16_t i = 0; i < length; i++)
+  {
+    hash = (uint16_t)(hash * 33) ^ name[i];
+  }
+  return hash;
+}
+
+MQTTTopicHandle MQTTTopicRegistry::Add(const uint8_t* encoded, uint16_t hash)
+{
+  uint16_t length = (pgm_read_byte(encoded) << 8) | pgm_read_byte(encoded + 1);
+  uint8_t slot = hash & tableMask;
+  while(table[slot] != 0)
+  {
+    MQTTTopicHandle handle = table[slot] - 1;
+    // Stejné téma registrované dvakrát dostane stejný handle
+    if(hashes[handle] == hash && GetWireLength(handle) == length + 2 && memcmp_P(wire[handle], encoded, length + 2) == 0)
+    {
+      return handle;
+    }
+    slot = (slot + 1) & tableMask;
+  }
+  if(count == capacity)
+  {
+    return MQTT_TOPIC_NONE;
+  }
+  wire[count] = encoded;
+  hashes[count] = hash;
+  table[slot] = count + 1;
+  return count++;
+}
+
+MQTTTopicHandle MQTTTopicRegistry::Find(const uint8_t* name, uint16_t length)
+{
+  uint16_t hash = Hash(name, length);
+  uint8_t slot = hash & tableMask;
+  while(table[slot] != 0)
+  {
+    MQTTTopicHandle handle = table[slot] - 1;
+    if(hashes[handle] == hash && GetWireLength(handle) == length + 2 && memcmp_P(name, wire[handle] + 2, length) == 0)
+    {
+      return handle;
+    }
+    slot = (slot + 1) & tableMask;
+  }
+  return MQTT_TOPIC_NONE;
+}
+
+const uint8_t* MQTTTopicRegistry::GetWire(MQTTTopicHandle handle)
+{
+  return wire[handle];
+}
+
+uint16_t MQTTTopicRegistry::GetWireLength(MQTTTopicHandle handle)
+{
+  return ((pgm_read_byte(wire[handle]) << 8) | pgm_read_byte(wire[handle] + 1)) + 2;
+}
+
+uint8_t MQTTTopicRegistry::GetCount()
+{
+  return count;
+}
+
+void MQTTTopicRegistry::PrintName(MQTTTopicHandle handle, Print* out)
+{
+  if(handle >= count)
+  {
+    return;
+  }
+  uint16_t length = GetWireLength(handle) - 2;
+  for(uint16_t i = 0; i < length; i++)
+  {
+    out->write(pgm_read_byte(wire[handle] + 2 + i));
+  }
+}
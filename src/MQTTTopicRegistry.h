@@ -0,0 +1,65 @@
+#ifndef __MQTTTOPICREGISTRY_H
+#define __MQTTTOPICREGISTRY_H
+
+#include <Arduino.h>
+
+typedef uint8_t MQTTTopicHandle;
+#define MQTT_TOPIC_NONE 0xFF
+
+// 16bitový hash jména tématu (djb2 s xor), stejný při překladu i za běhu
+constexpr uint16_t MQTTTopicHash(const char* text, uint16_t hash = 5381)
+{
+  return *text == '\0' ? hash : MQTTTopicHash(text + 1, (uint16_t)((uint16_t)(hash * 33) ^ (uint8_t)*text));
+}
+
+/*
+  Téma připravené při překladu: hash, délka (2 B, big endian) a jméno bez '\0' leží za sebou,
+  od length je to přesně kódování tématu v paketu PUBLISH.
+*/
+template<uint16_t N>
+struct MQTTTopicLiteral
+{
+  uint16_t hash;
+  uint8_t length[2];
+  char name[N];
+};
+
+// MQTT_TOPIC(tempTopic, "home/temp"); vytvoří téma ve flash, registruje se přes registry.Register(tempTopic)
+#define MQTT_TOPIC(var, text) \
+  static const MQTTTopicLiteral<sizeof(text)> var PROGMEM = { MQTTTopicHash(text), { (sizeof(text) - 1) >> 8, (sizeof(text) - 1) & 0xFF }, text }
+
+/*
+  Tabulka témat s malými čísly (handle) místo řetězců. Publish podle handle kopíruje hotové
+  kódování z flash, příchozí téma se najde hashem (otevřená adresace) a porovná s flash.
+*/
+class MQTTTopicRegistry
+{
+  private:
+    // Adresa kódování ve flash (délka + jméno)
+    const uint8_t** wire;
+    uint16_t* hashes;
+    uint8_t capacity;
+    uint8_t count = 0;
+    // Index + 1 do wire, 0 = volno; velikost je mocnina dvou, aspoň 2x capacity
+    uint8_t* table;
+    uint8_t tableMask;
+
+    MQTTTopicHandle Add(const uint8_t* encoded, uint16_t hash);
+
+  public:
+    MQTTTopicRegistry(uint8_t capacity);
+    template<uint16_t N>
+    MQTTTopicHandle Register(const MQTTTopicLiteral<N>& topic)
+    {
+      return Add(topic.length, pgm_read_word(&topic.hash));
+    }
+    MQTTTopicHandle Find(const uint8_t* name, uint16_t length);
+    // Kódování v paketu (délka + jméno), adresa ve flash
+    const uint8_t* GetWire(MQTTTopicHandle handle);
+    uint16_t GetWireLength(MQTTTopicHandle handle);
+    uint8_t GetCount();
+    void PrintName(MQTTTopicHandle handle, Print* out);
+    static uint16_t Hash(const uint8_t* name, uint16_t length);
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef __RTTESTIMATOR_H
+#define __RTTESTIMATOR_H
+
+#include <Arduino.h>
+
+// Smoothed round trip time (RFC 6298 style, integer milliseconds).
+struct RttEstimator
+{
+  uint16_t srtt = 0;
+  uint16_t rttVar = 0;
+  uint16_t minRtt = 0xFFFF;
+  uint16_t maxRtt = 0;
+  uint16_t samples = 0;
+
+  void Sample(unsigned long rtt)
+  {
+    uint16_t r = rtt > 0xFFFF ? 0xFFFF : (uint16_t)rtt;
+    if(samples == 0)
+    {
+      srtt = r;
+      rttVar = r / 2;
+    }
+    else
+    {
+      uint16_t delta = r > srtt ? r - srtt : srtt - r;
+      rttVar = (uint16_t)(((uint32_t)rttVar * 3 + delta) / 4);
+      srtt = (uint16_t)(((uint32_t)srtt * 7 + r) / 8);
+    }
+    minRtt = min(minRtt, r);
+    maxRtt = max(maxRtt, r);
+    samples = samples == 0xFFFF ? samples : samples + 1;
+  }
+
+  // srtt + 4 * rttvar, clamped to <minTimeout, maxTimeout>. Without samples defaultTimeout is used.
+  unsigned long Timeout(unsigned long defaultTimeout, unsigned long minTimeout, unsigned long maxTimeout) const
+  {
+    unsigned long timeout = samples == 0 ? defaultTimeout : (unsigned long)srtt + 4UL * rttVar;
+    if(timeout > maxTimeout)
+    {
+      timeout = maxTimeout;
+    }
+    if(timeout < minTimeout)
+    {
+      timeout = minTimeout;
+    }
+    return timeout;
+  }
+
+  void Reset()
+  {
+    srtt = rttVar = 0;
+    minRtt = 0xFFFF;
+    maxRtt = 0;
+    samples = 0;
+  }
+};
+
+#endif